@@ -0,0 +1,105 @@
+// Offset computation with partially static strides against fully dynamic extents.
+//
+//   g++ -std=c++17 -O3 -march=native bench/layout.cpp -o layout_bench && ./layout_bench
+//
+// The same 4-d shape {n0, 16, n2, 3} is mapped three ways: extents<dynamic_dims> (every stride
+// loaded at run time), extents<4,dynamic_extent,16,dynamic_extent,3> (strides 2 and 3 constant)
+// and extents<4,64,16,64,3> (all strides constant). Each kernel is run on a row-major sweep,
+// a transposed sweep and a gather through random multi-indices.
+
+#include "../includes/layout.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace mdspan;
+
+namespace{
+
+    constexpr ptrdiff_t n0 = 64, n1 = 16, n2 = 64, n3 = 3;
+
+    template< typename F >
+    double best_of(int reps, F&& f){
+        auto best = 1e300;
+        for(auto r = 0; r < reps; r++){
+            auto const t0 = std::chrono::steady_clock::now();
+            f();
+            auto const t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+
+    template< typename M >
+    float sweep(M const& m, float const* a){
+        auto s = 0.f;
+        for(auto i = ptrdiff_t{0}; i < n0; i++)
+            for(auto j = ptrdiff_t{0}; j < n1; j++)
+                for(auto k = ptrdiff_t{0}; k < n2; k++)
+                    for(auto l = ptrdiff_t{0}; l < n3; l++)
+                        s += a[ m(i, j, k, l) ];
+        return s;
+    }
+
+    template< typename M >
+    float transposed(M const& m, float const* a){
+        auto s = 0.f;
+        for(auto l = ptrdiff_t{0}; l < n3; l++)
+            for(auto k = ptrdiff_t{0}; k < n2; k++)
+                for(auto j = ptrdiff_t{0}; j < n1; j++)
+                    for(auto i = ptrdiff_t{0}; i < n0; i++)
+                        s += a[ m(i, j, k, l) ];
+        return s;
+    }
+
+    template< typename M >
+    float gather(M const& m, float const* a, std::vector<ptrdiff_t> const& idx){
+        auto s = 0.f;
+        for(auto p = size_t{0}; p < idx.size(); p += 4u)
+            s += a[ m(idx[p], idx[p + 1u], idx[p + 2u], idx[p + 3u]) ];
+        return s;
+    }
+
+    template< typename M >
+    void run(char const* name, M const& m, float const* a, std::vector<ptrdiff_t> const& idx){
+        volatile auto sink = 0.f;
+        auto const n = double(n0 * n1 * n2 * n3);
+        auto const t_sweep = best_of(20, [&]{ sink = sweep(m, a); });
+        auto const t_trans = best_of(20, [&]{ sink = transposed(m, a); });
+        auto const t_gather = best_of(20, [&]{ sink = gather(m, a, idx); });
+        std::printf("%-28s %8.3f %8.3f %8.3f\n", name,
+            1e9 * t_sweep / n, 1e9 * t_trans / n, 1e9 * t_gather / double(idx.size() / 4u));
+        (void)sink;
+    }
+
+}
+
+int main(){
+    auto a = std::vector<float>( size_t(n0 * n1 * n2 * n3), 1.f );
+
+    auto g = std::mt19937(42);
+    auto idx = std::vector<ptrdiff_t>{};
+    for(auto p = 0; p < ( 1 << 20 ); p++){
+        idx.push_back( ptrdiff_t( g() % n0 ) );
+        idx.push_back( ptrdiff_t( g() % n1 ) );
+        idx.push_back( ptrdiff_t( g() % n2 ) );
+        idx.push_back( ptrdiff_t( g() % n3 ) );
+    }
+
+    // keep the run-time extents opaque to the optimizer
+    volatile ptrdiff_t v0 = n0, v2 = n2;
+    ptrdiff_t const d0 = v0, d2 = v2;
+
+    auto const dyn = layout_right::mapping< extents<dynamic_dims> >( extents<dynamic_dims>{d0, n1, d2, n3} );
+    auto const mixed = layout_right::mapping< extents<4, dynamic_extent, n1, dynamic_extent, n3> >( { d0, d2 } );
+    auto const fixed = layout_right::mapping< extents<4, n0, n1, n2, n3> >{ {} };
+
+    std::printf("ns per element                  sweep   transp   gather\n");
+    run("extents<dynamic_dims>", dyn, a.data(), idx);
+    run("extents<4,dyn,16,dyn,3>", mixed, a.data(), idx);
+    run("extents<4,64,16,64,3>", fixed, a.data(), idx);
+    std::printf("stored strides: dynamic_dims %zu, mixed %zu, static %zu\n",
+        size_t{4}, mixed.rank_dynamic_strides(), fixed.rank_dynamic_strides());
+}
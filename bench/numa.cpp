@@ -0,0 +1,94 @@
+// Memory bandwidth per NUMA node and per dense storage placement.
+//
+//   g++ -std=c++17 -O3 -march=native -pthread bench/numa.cpp -o numa_bench && ./numa_bench [MiB]
+//
+// Part 1 binds a buffer to each node in turn and reads it with the CPUs of each node, giving the
+// node x node bandwidth matrix. Part 2 runs test::parallel_transform on tensors whose storage was
+// filled serially (std::vector), first-touched by numa::parallel_for or interleaved.
+
+#include "../includes/tensor_parallel.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+
+namespace{
+
+    template< typename F >
+    double best_of(int reps, F&& f){
+        auto best = 1e300;
+        for(auto r = 0; r < reps; r++){
+            auto const t0 = std::chrono::steady_clock::now();
+            f();
+            auto const t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+
+    /** @brief Reads n doubles with one thread per CPU of cpus, returns GB/s */
+    double read_bandwidth(double const* p, size_t n, std::vector<int> const& cpus){
+        auto partial = std::vector<double>(cpus.size());
+        auto const t = best_of(5, [&]{
+            parallel::parallel_for(n, [&](size_t b, size_t e, size_t part){
+                auto const pin = numa::scoped_pin( cpus[part] );
+                partial[part] = std::accumulate(p + b, p + e, 0.0);
+            }, cpus.size());
+        });
+        volatile auto sink = std::accumulate(partial.begin(), partial.end(), 0.0);
+        (void)sink;
+        return double(n * sizeof(double)) / t * 1e-9;
+    }
+
+    template< typename A >
+    void triad(char const* name, size_t n){
+        using tensor_type = test::tensor< double, test::dims<mdspan::dynamic_dims>, int, A >;
+        auto const e = test::dims<mdspan::dynamic_dims>{ ptrdiff_t(n) };
+        auto a = tensor_type(e, 1.0);
+        auto c = tensor_type(e, 2.0);
+        auto out = tensor_type(e, storage_type::uninitialized);
+        test::parallel_fill(out, 0.0);
+        auto const t = best_of(5, [&]{
+            test::parallel_transform(a, c, out, [](double x, double y){ return x + 3.0 * y; });
+        });
+        std::printf("  %-22s %8.2f GB/s\n", name, 3.0 * double(n * sizeof(double)) / t * 1e-9);
+    }
+
+}
+
+int main(int argc, char** argv){
+    auto const mib = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 512ul;
+    auto const n = size_t(mib) * ( size_t{1} << 20 ) / sizeof(double);
+    auto const& topo = numa::topology();
+
+    std::printf("%zu node(s), %zu usable cpu(s), %lu MiB per buffer\n", topo.nodes.size(), topo.cpus.size(), mib);
+
+    std::printf("\nread GB/s, rows: memory node, columns: cpu node\n      ");
+    for(auto c : topo.nodes){
+        std::printf("%8d", c);
+    }
+    std::printf("\n");
+    for(auto m : topo.nodes){
+        auto buf = numa::first_touch_vector<double>(n);
+        auto const bound = numa::bind(buf.data(), n * sizeof(double), m);
+        std::fill(buf.begin(), buf.end(), 1.0);
+        std::printf("%4d%s ", m, bound ? " " : "?");
+        for(auto c : topo.nodes){
+            auto cpus = std::vector<int>{};
+            for(auto i = size_t{0}; i < topo.cpus.size(); i++){
+                if( topo.cpu_node[i] == c ) cpus.push_back( topo.cpus[i] );
+            }
+            if( cpus.empty() ){
+                cpus.push_back(-1);
+            }
+            std::printf("%8.2f", read_bandwidth(buf.data(), n, cpus));
+        }
+        std::printf("\n");
+    }
+    std::printf("('?' marks a node the buffer could not be bound to)\n");
+
+    std::printf("\nparallel_transform out = a + 3 c on %zu thread(s)\n", parallel::concurrency());
+    triad< std::vector<double> >("std::vector (serial)", n);
+    triad< numa::first_touch_vector<double> >("first_touch_vector", n);
+    triad< numa::interleaved_vector<double> >("interleaved_vector", n);
+}
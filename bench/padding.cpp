@@ -0,0 +1,93 @@
+// Mode-1 traversal and a mode-1/2 transpose of {16, N, N} float tensors with and without padded
+// strides.
+//
+//   g++ -std=c++17 -O3 -march=native bench/padding.cpp -o padding_bench && ./padding_bench
+//
+// The walk reads one column of a block of 64 rows of mode 1 (the middle index), one element per
+// cache line, and the next pass reads the neighbouring column from the same 64 lines, which fit
+// into L1 unless they collide. The transpose copies 16 x 16 blocks, reading 16 lines of the input
+// and writing 16 lines of the output a row stride apart at the same time.
+//
+// With layout_right the row stride is N floats, a power-of-two multiple of 512 bytes, so the lines
+// of a column fold onto a few cache sets; layout_padded_for<float> steps by N + 16 floats instead.
+// On a core with a 48 KiB 12-way L1 and a 2 MiB L2 the transpose runs about 1.7x faster padded
+// for N = 1024 (5.6 vs 3.3 ns/elem) and 1.3x for N = 512. The walk does not gain: its conflict
+// misses hit L2 behind the stride prefetcher, and from run to run the padded walk was up to 40%
+// slower or up to 30% faster. Padding pays off for kernels that keep many lines of one column
+// live at once, not for streaming down a mode, so measure before choosing it.
+
+#include "../includes/layout.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using namespace mdspan;
+
+namespace{
+
+    template< typename F >
+    double best_of(int reps, F&& f){
+        auto best = 1e300;
+        for(auto r = 0; r < reps; r++){
+            auto const t0 = std::chrono::steady_clock::now();
+            f();
+            auto const t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+
+    constexpr ptrdiff_t rows = 64;
+
+    // one element per line and visit: column l of a block of rows is walked before column l + 1;
+    // the strides are read once so the loop measures the memory accesses, not the mapping call
+    template< typename M >
+    float mode1(M const& m, float const* a, ptrdiff_t n0, ptrdiff_t n1, ptrdiff_t n2){
+        auto const s0 = m.stride(0), s1 = m.stride(1);
+        auto s = 0.f;
+        for(auto i = ptrdiff_t{0}; i < n0; i++)
+            for(auto j0 = ptrdiff_t{0}; j0 < n1; j0 += rows)
+                for(auto l = ptrdiff_t{0}; l < n2; l++)
+                    for(auto j = j0; j < std::min(j0 + rows, n1); j++)
+                        s += a[ i * s0 + j * s1 + l ];
+        return s;
+    }
+
+    constexpr ptrdiff_t block = 16;
+
+    // b(i, l, j) = a(i, j, l) for square modes 1 and 2, in block x block tiles
+    template< typename M >
+    void transpose12(M const& m, float const* a, float* b, ptrdiff_t n0, ptrdiff_t n1){
+        auto const s0 = m.stride(0), s1 = m.stride(1);
+        for(auto i = ptrdiff_t{0}; i < n0; i++)
+            for(auto j0 = ptrdiff_t{0}; j0 < n1; j0 += block)
+                for(auto l0 = ptrdiff_t{0}; l0 < n1; l0 += block)
+                    for(auto j = j0; j < std::min(j0 + block, n1); j++)
+                        for(auto l = l0; l < std::min(l0 + block, n1); l++)
+                            b[ i * s0 + l * s1 + j ] = a[ i * s0 + j * s1 + l ];
+    }
+
+    template< typename M >
+    void run(char const* name, M const& m){
+        auto const& e = m.extents();
+        auto a = std::vector<float>( size_t( m.required_span_size() ), 1.f );
+        auto b = std::vector<float>( a.size(), 0.f );
+        volatile auto sink = 0.f;
+        auto const n = double( e[0] * e[1] * e[2] );
+        auto const walk = best_of(3, [&]{ sink = mode1(m, a.data(), e[0], e[1], e[2]); });
+        auto const swap = best_of(3, [&]{ transpose12(m, a.data(), b.data(), e[0], e[1]); });
+        std::printf("%-22s {%td,%td,%td} stride(1) %6td  walk %8.3f  transpose %8.3f ns/elem\n", name, e[0], e[1], e[2], m.stride(1),
+                    1e9 * walk / n, 1e9 * swap / n);
+        (void)sink;
+    }
+
+}
+
+int main(){
+    for(auto n : {ptrdiff_t{1024}, ptrdiff_t{512}, ptrdiff_t{256}}){
+        auto const e = extents<dynamic_dims>{16, n, n};
+        run("layout_right", layout_right::mapping< extents<dynamic_dims> >(e));
+        run("layout_padded_for<f>", layout_padded_for<float>::mapping< extents<dynamic_dims> >(e));
+    }
+}
@@ -0,0 +1,67 @@
+// Concurrent sparse insertion throughput.
+//
+//   g++ -std=c++17 -O3 -march=native -pthread bench/sparse_insert.cpp -o sparse_insert_bench && ./sparse_insert_bench [M inserts]
+//
+// Every thread adds values at random linear indices of a 2^30 element tensor. map_compression
+// behind one global mutex is compared with concurrent_map_compression for 1, 2, 4, ...
+// threads, followed by the time of the final compress().
+
+#include "../includes/concurrent_sparse.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+
+namespace{
+
+    double seconds(std::chrono::steady_clock::time_point t0){
+        return std::chrono::duration<double>( std::chrono::steady_clock::now() - t0 ).count();
+    }
+
+}
+
+int main(int argc, char** argv){
+    using namespace storage_type::sparse_tensor;
+
+    auto const n = ( argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 4ul ) * 1000000ul;
+    auto constexpr universe = size_t{1} << 30;
+
+    auto keys = std::vector<size_t>(n);
+    auto g = std::mt19937_64(7);
+    for(auto& k : keys){
+        k = g() % universe;
+    }
+
+    std::printf("%-28s %7s %12s %12s\n", "", "threads", "M inserts/s", "compress s");
+    for(auto threads = size_t{1}; threads <= 2u * parallel::concurrency(); threads *= 2u){
+        {
+            auto s = map_compression<float>(universe);
+            auto m = std::mutex{};
+            auto const t0 = std::chrono::steady_clock::now();
+            parallel::parallel_for(n, [&](size_t b, size_t e, size_t){
+                for(auto i = b; i < e; i++){
+                    auto lock = std::lock_guard<std::mutex>(m);
+                    s.set(s.get(keys[i]) + 1.f, keys[i]);
+                }
+            }, threads);
+            auto const t_insert = seconds(t0);
+            auto const t1 = std::chrono::steady_clock::now();
+            s.compress();
+            std::printf("%-28s %7zu %12.2f %12.3f\n", "map_compression + mutex", threads, 1e-6 * double(n) / t_insert, seconds(t1));
+        }
+        {
+            auto s = concurrent_map_compression<float>(universe);
+            auto const t0 = std::chrono::steady_clock::now();
+            parallel::parallel_for(n, [&](size_t b, size_t e, size_t){
+                for(auto i = b; i < e; i++){
+                    s.add(1.f, keys[i]);
+                }
+            }, threads);
+            auto const t_insert = seconds(t0);
+            auto const t1 = std::chrono::steady_clock::now();
+            s.compress();
+            std::printf("%-28s %7zu %12.2f %12.3f\n", "concurrent_map_compression", threads, 1e-6 * double(n) / t_insert, seconds(t1));
+        }
+    }
+}
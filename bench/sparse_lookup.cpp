@@ -0,0 +1,73 @@
+// Point lookups on compressed sparse storage: binary search against the index_table.
+//
+//   g++ -std=c++17 -O3 -march=native bench/sparse_lookup.cpp -o sparse_lookup_bench && ./sparse_lookup_bench [nnz]
+//
+// A map_compression<double> holds nnz random indices of a 2^34 universe. The same random keys,
+// half of them stored, are looked up by std::lower_bound over index(), by at() and by gather().
+
+#include "../includes/storage_policy.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace storage_type::sparse_tensor;
+
+namespace{
+
+    template< typename F >
+    double best_of(int reps, F&& f){
+        auto best = 1e300;
+        for(auto r = 0; r < reps; r++){
+            auto const t0 = std::chrono::steady_clock::now();
+            f();
+            auto const t1 = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+        }
+        return best;
+    }
+
+}
+
+int main(int argc, char** argv){
+    auto const nnz = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000ul;
+    auto const universe = size_t{1} << 34;
+
+    auto g = std::mt19937_64(7);
+    auto s = map_compression<double>(universe);
+    for(auto i = size_t{0}; i < nnz; i++){
+        s.set(double(i), g() % universe);
+    }
+    s.compress();
+
+    auto keys = std::vector<size_t>(1u << 22);
+    for(auto i = size_t{0}; i < keys.size(); i++){
+        keys[i] = i % 2 ? g() % universe : s.index()[ g() % s.index().size() ];
+    }
+    auto out = std::vector<double>(keys.size());
+    auto const& index = s.index();
+    auto const& values = s.values();
+
+    auto const t_bin = best_of(5, [&]{
+        for(auto i = size_t{0}; i < keys.size(); i++){
+            auto const it = std::lower_bound(index.begin(), index.end(), keys[i]);
+            out[i] = it != index.end() && *it == keys[i] ? values[ size_t( it - index.begin() ) ] : 0.0;
+        }
+    });
+    auto const t_at = best_of(5, [&]{
+        for(auto i = size_t{0}; i < keys.size(); i++){
+            out[i] = s.at(keys[i]);
+        }
+    });
+    auto const t_gather = best_of(5, [&]{
+        s.gather(keys.data(), keys.size(), out.data());
+    });
+
+    auto const n = double(keys.size());
+    std::printf("nnz %zu, %zu buckets of 2^%zu indices (%.1f bytes per element)\n",
+        s.nnz(), s.table().buckets(), s.table().shift(), 4.0 * double(s.table().buckets()) / double(s.nnz()));
+    std::printf("  binary search %8.1f ns/lookup\n", 1e9 * t_bin / n);
+    std::printf("  at()          %8.1f ns/lookup\n", 1e9 * t_at / n);
+    std::printf("  gather()      %8.1f ns/lookup\n", 1e9 * t_gather / n);
+}
@@ -0,0 +1,203 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "tensor.h"
+#include "instrumentation.h"
+#include <array>
+#include <utility>
+
+namespace test{
+    using namespace mdspan;
+
+    template< typename T, typename E >
+    struct batch;
+
+    /** @brief N tensors of one fully static shape in a single batch-innermost allocation
+     *
+     * Element k (linear index, last index fastest) of tensor b lives at data()[k * count() + b], so
+     * every element position is a contiguous lane over the batch and the batch_* kernels vectorize
+     * across tensors instead of within one tiny tensor.
+     *
+     * @code auto b = batch<float, dims<3,1,2,3>>( 1000000 );
+     *
+     * @tparam T value type
+     * @tparam E extents type whose extents are all static
+     */
+    template< typename T, ptrdiff_t D, ptrdiff_t ... Es >
+    struct batch< T, extents<D, Es...> >{
+        using extents_type = mdspan::extents<D, Es...>;
+        using value_type = T;
+        using array_type = storage_type::dense_tensor::uninitialized_vector<T>;
+
+        static_assert( sizeof...(Es) > 0 && extents_type::rank_dyanmic() == 0, "batch requires fully static extents" );
+
+        /** @brief Number of elements of one tensor */
+        static constexpr size_t elements = ( size_t{1} * ... * static_cast<size_t>(Es) );
+
+        batch() = default;
+
+        /** @brief Constructs n value-initialized tensors */
+        explicit batch(size_t n)
+            : _n(n), _data( storage_type::storage_traits<array_type>::make(n * elements, storage_type::value_initialized) ){}
+
+        /** @brief Constructs n tensors without initializing their elements */
+        batch(size_t n, storage_type::uninitialized_t tag)
+            : _n(n), _data( storage_type::storage_traits<array_type>::make(n * elements, tag) ){}
+
+        static constexpr extents_type extents() noexcept{ return extents_type{}; }
+
+        /** @brief Number of tensors in the batch */
+        size_t count() const noexcept{ return _n; }
+
+        size_t size() const noexcept{ return _data.size(); }
+
+        T& operator()(size_t b, size_t k) noexcept{ return _data[k * _n + b]; }
+        T const& operator()(size_t b, size_t k) const noexcept{ return _data[k * _n + b]; }
+
+        /** @brief Contiguous lane of element k over all tensors */
+        T* lane(size_t k) noexcept{ return _data.data() + k * _n; }
+        T const* lane(size_t k) const noexcept{ return _data.data() + k * _n; }
+
+        T* data() noexcept{ return _data.data(); }
+        T const* data() const noexcept{ return _data.data(); }
+
+        /** @brief Copies the row-major elements of src into tensor b */
+        void store(size_t b, T const* src) noexcept{
+            for(auto k = size_t{0}; k < elements; k++){
+                _data[k * _n + b] = src[k];
+            }
+        }
+
+        /** @brief Copies tensor b into dst in row-major order */
+        void load(size_t b, T* dst) const noexcept{
+            for(auto k = size_t{0}; k < elements; k++){
+                dst[k] = _data[k * _n + b];
+            }
+        }
+
+    private:
+        size_t _n{0};
+        array_type _data;
+    };
+
+    /** @brief out(b,k) = f(a(b,k)) for every tensor b and element k */
+    template< typename T, typename E, typename U, typename F >
+    void batch_transform(batch<T,E> const& a, batch<U,E>& out, F f){
+        assert( a.count() == out.count() );
+        auto timer = instrumentation::scoped_kernel("batch_transform", a.size() * ( sizeof(T) + sizeof(U) ));
+        auto const* p = a.data();
+        auto* q = out.data();
+        for(auto i = size_t{0}; i < a.size(); i++){
+            q[i] = f(p[i]);
+        }
+    }
+
+    /** @brief out(b,k) = f(a(b,k), c(b,k)) for every tensor b and element k */
+    template< typename T, typename S, typename E, typename U, typename F >
+    void batch_transform(batch<T,E> const& a, batch<S,E> const& c, batch<U,E>& out, F f){
+        assert( a.count() == c.count() && a.count() == out.count() );
+        auto timer = instrumentation::scoped_kernel("batch_transform", a.size() * ( sizeof(T) + sizeof(S) + sizeof(U) ));
+        auto const* p = a.data();
+        auto const* r = c.data();
+        auto* q = out.data();
+        for(auto i = size_t{0}; i < a.size(); i++){
+            q[i] = f(p[i], r[i]);
+        }
+    }
+
+    /** @brief Reduces every tensor of the batch to one value: out[b] = op(...op(init, a(b,0))..., a(b,n-1))
+     *
+     * @param out array of at least a.count() elements
+     */
+    template< typename T, typename E, typename R, typename Op >
+    void batch_reduce(batch<T,E> const& a, R init, Op op, R* out){
+        auto timer = instrumentation::scoped_kernel("batch_reduce", a.size() * sizeof(T));
+        auto const n = a.count();
+        for(auto b = size_t{0}; b < n; b++){
+            out[b] = init;
+        }
+        for(auto k = size_t{0}; k < batch<T,E>::elements; k++){
+            auto const* p = a.lane(k);
+            for(auto b = size_t{0}; b < n; b++){
+                out[b] = op(out[b], p[b]);
+            }
+        }
+    }
+
+    namespace detail{
+
+        template< ptrdiff_t ... Es, size_t ... I >
+        constexpr auto drop_last(std::index_sequence<I...>){
+            constexpr std::array<ptrdiff_t, sizeof...(Es)> e = {Es...};
+            return std::integer_sequence<ptrdiff_t, e[I]...>{};
+        }
+
+        template< typename Lhs, typename Rhs >
+        struct batch_contract_extents;
+
+        template< ptrdiff_t ... L, ptrdiff_t ... R >
+        struct batch_contract_extents< std::integer_sequence<ptrdiff_t, L...>, std::integer_sequence<ptrdiff_t, R...> >{
+            using type = extents< ptrdiff_t( sizeof...(L) + sizeof...(R) ), L..., R... >;
+        };
+
+        template< ptrdiff_t ... Es >
+        using drop_last_t = decltype( drop_last<Es...>( std::make_index_sequence<sizeof...(Es) - 1>{} ) );
+
+    }
+
+    /** @brief Contracts the last mode of every tensor of a with the first mode of the same tensor of c
+     *
+     * For a of shape (i..., k) and c of shape (k, j...) the result has shape (i..., j...):
+     * out(b, i..., j...) = sum_k a(b, i..., k) * c(b, k, j...).
+     * The batch is processed in tiles so the accumulators of a tile stay in cache and the innermost
+     * loop runs over contiguous batch lanes.
+     *
+     * @code auto c = batch_contract( batch<float,dims<2,3,4>>(n), batch<float,dims<2,4,5>>(n) ); // dims<2,3,5>
+     */
+    template< typename T, ptrdiff_t DA, ptrdiff_t ... A, ptrdiff_t DC, ptrdiff_t C0, ptrdiff_t ... C >
+    auto batch_contract(batch< T, extents<DA, A...> > const& a, batch< T, extents<DC, C0, C...> > const& c){
+        constexpr std::array<ptrdiff_t, sizeof...(A)> ea = {A...};
+        static_assert( ea[sizeof...(A) - 1] == C0, "contracted extents differ" );
+        static_assert( sizeof...(A) + sizeof...(C) >= 2, "use batch_reduce for a full contraction" );
+
+        using out_extents = typename detail::batch_contract_extents< detail::drop_last_t<A...>, std::integer_sequence<ptrdiff_t, C...> >::type;
+
+        assert( a.count() == c.count() );
+        auto const n = a.count();
+        auto out = batch<T, out_extents>(n, storage_type::uninitialized);
+
+        constexpr auto K = static_cast<size_t>(C0);
+        constexpr auto I = batch< T, extents<DA, A...> >::elements / K;
+        constexpr auto J = batch< T, extents<DC, C0, C...> >::elements / K;
+        constexpr auto tile = size_t{256};
+
+        auto timer = instrumentation::scoped_kernel("batch_contract", ( a.size() + c.size() + out.size() ) * sizeof(T));
+
+        T acc[tile];
+        for(auto b0 = size_t{0}; b0 < n; b0 += tile){
+            auto const m = std::min(tile, n - b0);
+            for(auto i = size_t{0}; i < I; i++){
+                for(auto j = size_t{0}; j < J; j++){
+                    for(auto b = size_t{0}; b < m; b++){
+                        acc[b] = T{};
+                    }
+                    for(auto k = size_t{0}; k < K; k++){
+                        auto const* pa = a.lane(i * K + k) + b0;
+                        auto const* pc = c.lane(k * J + j) + b0;
+                        for(auto b = size_t{0}; b < m; b++){
+                            acc[b] += pa[b] * pc[b];
+                        }
+                    }
+                    auto* po = out.lane(i * J + j) + b0;
+                    for(auto b = size_t{0}; b < m; b++){
+                        po[b] = acc[b];
+                    }
+                }
+            }
+        }
+        return out;
+    }
+
+}
+
+#endif // BATCH_H
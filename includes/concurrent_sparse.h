@@ -0,0 +1,286 @@
+#ifndef CONCURRENT_SPARSE_H
+#define CONCURRENT_SPARSE_H
+
+#include "sparse_builder.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace storage_type::sparse_tensor{
+
+    /** @brief Sparse storage that many threads may set(), add() and read concurrently
+     *
+     * Pending insertions live in a hash map split into shards, each behind its own lock on its own
+     * cache line; the shard of an index is picked by a multiplicative hash, so threads inserting
+     * different indices rarely meet on a lock. compress() gathers every shard and sorts the entries
+     * in parallel with sort_entries() into the same sorted index/value arrays and index_table as
+     * map_compression.
+     *
+     * @code auto s = concurrent_map_compression<float>( e.product() );
+     * @code parallel::parallel_for( n, [&](size_t b, size_t e, size_t){ for(...) s.add(v, k); } );
+     * @code s.compress();
+     *
+     * @note compress(), uncompress(), moves and assignment must not run concurrently with other members
+     */
+    template< typename T >
+    struct concurrent_map_compression: storage_interface<T>{
+        using index_array = sparse_tensor::index_array;
+        using value_array = dense_tensor::uninitialized_vector<T>;
+
+        concurrent_map_compression()
+            : concurrent_map_compression(0){}
+
+        /** @param n number of elements of the dense tensor, the length of uncompress()
+         *  @param shards number of lock shards, rounded up to a power of two */
+        explicit concurrent_map_compression(size_t n, size_t shards = 8u * parallel::concurrency())
+            : _n(n)
+        {
+            auto s = size_t{1};
+            while( s < shards ){
+                s <<= 1u;
+            }
+            _shift = 64u;
+            for(auto x = s; x > 1u; x >>= 1u){
+                _shift--;
+            }
+            _count = s;
+            _shards = std::make_unique<shard[]>(s);
+        }
+
+        /** @brief Copies other, holding all its shard locks so concurrent insertions are not torn */
+        concurrent_map_compression(concurrent_map_compression const& other)
+            : _n(other._n), _shift(other._shift), _count(other._count), _shards( std::make_unique<shard[]>(other._count) )
+        {
+            auto locks = std::vector<std::unique_lock<std::mutex>>{};
+            locks.reserve(_count);
+            for(auto i = size_t{0}; i < _count; i++){
+                locks.emplace_back(other._shards[i].m);
+            }
+            _index = other._index;
+            _values = other._values;
+            _table = other._table;
+            for(auto i = size_t{0}; i < _count; i++){
+                _shards[i].map = other._shards[i].map;
+            }
+        }
+
+        /** @note other is left empty with a single shard, so it stays usable */
+        concurrent_map_compression(concurrent_map_compression&& other)
+            : concurrent_map_compression(0, 1)
+        {
+            swap(other);
+        }
+
+        concurrent_map_compression& operator=(concurrent_map_compression const& other){
+            if( this != &other ){
+                auto copy = concurrent_map_compression(other);
+                swap(copy);
+            }
+            return *this;
+        }
+
+        concurrent_map_compression& operator=(concurrent_map_compression&& other) noexcept{
+            swap(other);
+            return *this;
+        }
+
+        void swap(concurrent_map_compression& other) noexcept{
+            using std::swap;
+            swap(_index, other._index);
+            swap(_values, other._values);
+            swap(_table, other._table);
+            swap(_n, other._n);
+            swap(_shift, other._shift);
+            swap(_count, other._count);
+            swap(_shards, other._shards);
+        }
+
+        void compress() override {
+            instrumentation::count(instrumentation::counter::sparse_compress);
+
+            // offsets of each shard's entries after the already compressed ones
+            auto offset = std::vector<size_t>(_count + 1u, _index.size());
+            for(auto i = size_t{0}; i < _count; i++){
+                offset[i + 1u] = offset[i] + _shards[i].map.size();
+            }
+            if( offset.back() == _index.size() ){
+                return;
+            }
+
+            auto const n = offset.back();
+            auto keys = index_array(n);
+            auto vals = value_array(n);
+            std::copy(_index.begin(), _index.end(), keys.begin());
+            std::move(_values.begin(), _values.end(), vals.begin());
+            auto universe = _index.empty() ? size_t{1} : _index.back() + 1u;
+            auto top = std::vector<size_t>(_count, 0);
+            parallel::parallel_for(_count, [&](size_t b, size_t e, size_t){
+                for(auto i = b; i < e; i++){
+                    auto o = offset[i];
+                    for(auto& [k, v] : _shards[i].map){
+                        keys[o] = k;
+                        vals[o++] = std::move(v);
+                        top[i] = std::max(top[i], k + 1u);
+                    }
+                    _shards[i].map.clear();
+                }
+            });
+            universe = std::max( universe, *std::max_element(top.begin(), top.end()) );
+
+            // indices are distinct across shards and the compressed arrays, so nothing is combined
+            auto s = sort_entries(keys.data(), vals.data(), n, universe);
+            _index = std::move(s.index);
+            _values = std::move(s.values);
+            _table = index_table(_index);
+        }
+
+        std::vector<T> uncompress() override {
+            auto n = _n;
+            if( n == 0 ){
+                n = _index.empty() ? 0 : _index.back() + 1u;
+                for(auto i = size_t{0}; i < _count; i++){
+                    for(auto const& [k, v] : _shards[i].map){
+                        n = std::max(n, k + 1u);
+                    }
+                }
+            }
+            auto r = std::vector<T>(n);
+            for(auto i = size_t{0}; i < _index.size(); i++){
+                r[_index[i]] = _values[i];
+            }
+            for(auto i = size_t{0}; i < _count; i++){
+                for(auto const& [k, v] : _shards[i].map){
+                    r[k] = v;
+                }
+            }
+            return r;
+        }
+
+        T at(size_t k) const override{
+            instrumentation::count(instrumentation::counter::sparse_at);
+            return find(k);
+        }
+
+        void set(T v, size_t k) override{
+            instrumentation::count(instrumentation::counter::sparse_set);
+            update(k, [&](T& x){ x = std::move(v); }, [&]{ return std::move(v); });
+        }
+
+        T get(size_t k) override{
+            instrumentation::count(instrumentation::counter::sparse_get);
+            return find(k);
+        }
+
+        /** @brief Element k becomes op(element k, v), or v if k is not stored yet */
+        template< typename Op >
+        void accumulate(T v, size_t k, Op op){
+            instrumentation::count(instrumentation::counter::sparse_set);
+            update(k, [&](T& x){ x = op(std::move(x), std::move(v)); }, [&]{ return std::move(v); });
+        }
+
+        /** @brief Element k becomes element k + v */
+        void add(T v, size_t k){
+            accumulate(std::move(v), k, std::plus<>{});
+        }
+
+        /** @brief Number of stored elements */
+        size_t nnz() const{
+            auto n = _index.size();
+            for(auto i = size_t{0}; i < _count; i++){
+                auto lock = std::lock_guard<std::mutex>(_shards[i].m);
+                n += _shards[i].map.size();
+            }
+            return n;
+        }
+
+        index_array const& index() const noexcept{ return _index; }
+        value_array const& values() const noexcept{ return _values; }
+
+    private:
+        struct alignas(64) shard{
+            mutable std::mutex m;
+            std::unordered_map<size_t,T> map;
+        };
+
+        shard& shard_of(size_t k) const noexcept{
+            // Fibonacci hashing; the top bits select the shard
+            auto const h = std::uint64_t(k) * 0x9E3779B97F4A7C15ull;
+            return _shards[ static_cast<size_t>( h >> ( _shift & 63u ) ) & ( _count - 1u ) ];
+        }
+
+        template< typename Update, typename Make >
+        void update(size_t k, Update&& upd, Make&& make){
+            auto& s = shard_of(k);
+            auto lock = std::lock_guard<std::mutex>(s.m);
+            // elements already compressed are updated in place, serialized by the same shard lock
+            auto const p = _table.find(_index, k);
+            if( p != index_table::npos ){
+                upd( _values[p] );
+                return;
+            }
+            auto const jt = s.map.find(k);
+            if( jt != s.map.end() ){
+                upd(jt->second);
+            }else{
+                s.map.emplace(k, make());
+            }
+        }
+
+        T find(size_t k) const{
+            auto& s = shard_of(k);
+            auto lock = std::lock_guard<std::mutex>(s.m);
+            auto const p = _table.find(_index, k);
+            if( p != index_table::npos ){
+                return _values[p];
+            }
+            auto const jt = s.map.find(k);
+            return jt == s.map.end() ? T{} : jt->second;
+        }
+
+        template< typename U >
+        friend map_compression<U> make_map_compression(concurrent_map_compression<U>&& s, size_t n);
+
+        index_array _index;
+        value_array _values;
+        index_table _table;
+        size_t _n{0};
+        size_t _shift{64};
+        size_t _count{0};
+        std::unique_ptr<shard[]> _shards;
+    };
+
+    /** @brief Adopts the compressed entries of s as map_compression storage */
+    template< typename T >
+    map_compression<T> make_map_compression(concurrent_map_compression<T>&& s, size_t n){
+        s.compress();
+        return map_compression<T>( std::move(s._index), std::move(s._values), n );
+    }
+
+}
+
+namespace storage_type{
+
+    template< typename T >
+    struct storage_traits< sparse_tensor::concurrent_map_compression<T> >{
+        using value_type = T;
+
+        /** @brief Sparse storage holds no elements up front; sizing allocates nothing */
+        static auto make(size_t n, uninitialized_t){
+            return sparse_tensor::concurrent_map_compression<T>(n);
+        }
+
+        static auto make(size_t n, value_initialized_t){
+            return sparse_tensor::concurrent_map_compression<T>(n);
+        }
+
+        /** @brief Unstored elements read as T{}, so a fill value cannot be honoured */
+        template< typename V >
+        static auto make(size_t, V const&){
+            static_assert( sizeof(V) == 0, "sparse storage cannot be filled with a value; construct it empty and set() the elements" );
+            return sparse_tensor::concurrent_map_compression<T>();
+        }
+    };
+
+}
+
+#endif // CONCURRENT_SPARSE_H
@@ -0,0 +1,226 @@
+#ifndef CONTRACTION_H
+#define CONTRACTION_H
+
+#include "tensor.h"
+#include "gemm.h"
+#include <vector>
+
+namespace test::detail{
+
+    /** @brief Returns the stride of the modes g merged into one, or -1 if they are not mergeable
+     *
+     * The modes g, in this order, merge into a single mode if each one's stride equals the
+     * stride times extent of the next. Modes of extent 1 are ignored. An empty group has stride 1.
+     */
+    inline ptrdiff_t merged_stride(std::vector<ptrdiff_t> const& e, std::vector<ptrdiff_t> const& s, std::vector<size_t> const& g){
+        auto last = ptrdiff_t{-1};
+        auto inner = ptrdiff_t{1};
+        for(auto i = g.size(); i-- > 0u;){
+            auto const m = g[i];
+            if( e[m] == 1 ){
+                continue;
+            }
+            if( last == -1 ){
+                last = s[m];
+            }else if( s[m] != inner ){
+                return -1;
+            }
+            inner = s[m] * e[m];
+        }
+        return last == -1 ? ptrdiff_t{1} : last;
+    }
+
+    /** @brief Copies the modes perm of src (last fastest) into the contiguous buffer dst */
+    template< typename T >
+    void permute_copy(T const* src, std::vector<ptrdiff_t> const& e, std::vector<ptrdiff_t> const& s,
+                      std::vector<size_t> const& perm, T* dst)
+    {
+        auto const r = perm.size();
+        if( r == 0 ){
+            *dst = *src;
+            return;
+        }
+        auto idx = std::vector<ptrdiff_t>(r, 0);
+        auto const inner_n = e[perm[r - 1]];
+        auto const inner_s = s[perm[r - 1]];
+        for(;;){
+            auto off = ptrdiff_t{0};
+            for(auto i = size_t{0}; i + 1 < r; i++){
+                off += idx[i] * s[perm[i]];
+            }
+            for(auto j = ptrdiff_t{0}; j < inner_n; j++){
+                *dst++ = src[off + j * inner_s];
+            }
+            auto i = r - 1;
+            while( i-- > 0u ){
+                if( ++idx[i] < e[perm[i]] ){
+                    break;
+                }
+                idx[i] = 0;
+            }
+            if( i == size_t(-1) ){
+                return;
+            }
+        }
+    }
+
+    /** @brief A group of modes of a tensor presented as one matrix dimension */
+    template< typename T >
+    struct matrix_operand{
+        T const* data;
+        ptrdiff_t rs;
+        ptrdiff_t cs;
+        storage_type::dense_tensor::uninitialized_vector<T> buffer;
+    };
+
+    /** @brief Presents the modes rows x cols of a row-major tensor as a matrix
+     *
+     * If both groups merge into a single stride the matrix is a zero-copy view, otherwise the
+     * tensor is permuted into a contiguous [rows..., cols...] buffer.
+     */
+    template< typename T >
+    matrix_operand<T> as_matrix(T const* data, std::vector<ptrdiff_t> const& e, std::vector<ptrdiff_t> const& s,
+                                std::vector<size_t> const& rows, std::vector<size_t> const& cols)
+    {
+        auto const rs = merged_stride(e, s, rows);
+        auto const cs = merged_stride(e, s, cols);
+        if( rs != -1 && cs != -1 ){
+            return { data, rs, cs, {} };
+        }
+
+        auto perm = rows;
+        perm.insert(perm.end(), cols.begin(), cols.end());
+        auto ncols = ptrdiff_t{1};
+        for(auto m : cols){
+            ncols *= e[m];
+        }
+        auto n = ncols;
+        for(auto m : rows){
+            n *= e[m];
+        }
+        auto op = matrix_operand<T>{ nullptr, ncols, 1, storage_type::dense_tensor::uninitialized_vector<T>( static_cast<size_t>(n) ) };
+        auto timer = instrumentation::scoped_kernel("permute", 2 * static_cast<size_t>(n) * sizeof(T));
+        permute_copy(data, e, s, perm, op.buffer.data());
+        op.data = op.buffer.data();
+        return op;
+    }
+
+    /** @brief Returns the modes 0, ..., rank - 1 that are not in modes, in increasing order */
+    inline std::vector<size_t> free_modes(size_t rank, std::vector<size_t> const& modes){
+        auto f = std::vector<size_t>{};
+        for(auto k = size_t{0}; k < rank; k++){
+            if( std::find(modes.begin(), modes.end(), k) == modes.end() ){
+                f.push_back(k);
+            }
+        }
+        return f;
+    }
+
+    /** @brief c = A * B for the m x k and k x n views, c zero on entry
+     *
+     * Products with a unit dimension skip the blocked gemm and its packing: m = n = 1 is a dot,
+     * k = 1 an outer product (ger), and n = 1 or m = 1 a gemv. The checks look at m, n and k
+     * rather than at the shapes of the operands, so a matrix contracted over both modes is a dot
+     * and a tensor whose free modes have extent 1 a gemv.
+     */
+    template< typename T >
+    void contract_kernel(size_t m, size_t n, size_t k, matrix_operand<T> const& A, matrix_operand<T> const& B, T* c){
+        if( m == 1 && n == 1 ){
+            c[0] = dot( k, A.data, A.cs, B.data, B.rs );
+            return;
+        }
+        if( k == 1 ){
+            ger( m, n, T{1}, A.data, A.rs, B.data, B.cs, c, ptrdiff_t(n), ptrdiff_t{1} );
+            return;
+        }
+        if( n == 1 ){
+            gemv( m, k, T{1}, A.data, A.rs, A.cs, B.data, B.rs, T{0}, c, ptrdiff_t{1} );
+            return;
+        }
+        if( m == 1 ){
+            gemv( n, k, T{1}, B.data, B.cs, B.rs, A.data, A.cs, T{0}, c, ptrdiff_t{1} );
+            return;
+        }
+        gemm( m, n, k, T{1}, A.data, A.rs, A.cs, B.data, B.rs, B.cs, T{0}, c, ptrdiff_t(n), ptrdiff_t{1} );
+    }
+
+    inline extents<dynamic_dims> remove_extent_items(extents<dynamic_dims> e, std::vector<size_t> modes){
+        std::sort(modes.begin(), modes.end(), std::greater<>());
+        for(auto m : modes){
+            e = remove_extent_item(e, m);
+        }
+        return e;
+    }
+
+}
+
+namespace test{
+
+    /** @brief Contracts the modes ma of a with the modes mb of b
+     *
+     * The result has the free modes of a followed by the free modes of b, each in their original
+     * order: c(i..., j...) = sum_k a(i..., k...) * b(k..., j...), where ma[q] is paired with mb[q].
+     * Both operands are presented as matrices, as zero-copy strided views whenever their mode groups
+     * are mergeable and by permuting into a buffer otherwise, and multiplied with test::gemm, or with
+     * a level 1 or 2 kernel when one of m, n or k is 1, see detail::contract_kernel.
+     *
+     * @code auto c = contract( a, b, {1,2}, {0,1} ); // a: {I,K1,K2}, b: {K1,K2,J} -> c: {I,J}
+     *
+     * @note a full contraction returns extents {1}
+     *
+     * @param a dense tensor
+     * @param b dense tensor
+     * @param ma modes of a to contract
+     * @param mb modes of b to contract, same count and extents as ma
+     */
+    template< typename T, typename EA, typename FA, typename AA, typename EB, typename FB, typename AB >
+    auto contract(tensor<T,EA,FA,AA> const& a, tensor<T,EB,FB,AB> const& b,
+                  std::vector<size_t> const& ma, std::vector<size_t> const& mb)
+    {
+        auto const ea = to_dynamic(a.extents());
+        auto const eb = to_dynamic(b.extents());
+
+        if( ma.size() != mb.size() ){
+            throw std::length_error("Error in contract() : number of contracted modes differ");
+        }
+        for(auto q = size_t{0}; q < ma.size(); q++){
+            if( ma[q] >= ea.rank() || mb[q] >= eb.rank() || ea[ma[q]] != eb[mb[q]] ){
+                throw std::length_error("Error in contract() : contracted extents differ");
+            }
+        }
+
+        auto const fa = detail::free_modes(ea.rank(), ma);
+        auto const fb = detail::free_modes(eb.rank(), mb);
+        if( fa.size() + ma.size() != ea.rank() || fb.size() + mb.size() != eb.rank() ){
+            throw std::length_error("Error in contract() : repeated contracted mode");
+        }
+
+        auto ec = concat_extent( detail::remove_extent_items(ea, ma), detail::remove_extent_items(eb, mb) );
+        if( ec.empty() ){
+            ec = extents<dynamic_dims>{1};
+        }
+
+        auto const& va = ea.base();
+        auto const& vb = eb.base();
+        auto const sa = row_major_strides(ea);
+        auto const sb = row_major_strides(eb);
+
+        auto prod = [](std::vector<ptrdiff_t> const& e, std::vector<size_t> const& g){
+            auto p = size_t{1};
+            for(auto m : g) p *= static_cast<size_t>(e[m]);
+            return p;
+        };
+        auto const m = prod(va, fa);
+        auto const n = prod(vb, fb);
+        auto const k = prod(va, ma);
+
+        auto c = tensor<T, dims<dynamic_dims>>( std::move(ec), storage_type::value_initialized );
+        auto const A = detail::as_matrix(a.data(), va, sa, fa, ma);
+        auto const B = detail::as_matrix(b.data(), vb, sb, mb, fb);
+        detail::contract_kernel( m, n, k, A, B, c.data() );
+        return c;
+    }
+
+}
+
+#endif // CONTRACTION_H
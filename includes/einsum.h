@@ -0,0 +1,707 @@
+#ifndef EINSUM_H
+#define EINSUM_H
+
+#include "contraction.h"
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace test{
+
+    /** @brief Pairwise contraction order of an einsum expression for one set of operand shapes
+     *
+     * Operands are referred to by id: ids below inputs.size() are the inputs, id inputs.size() + t
+     * is the result of steps[t]. Every step consumes its two operands.
+     */
+    struct einsum_plan{
+        struct step{
+            size_t lhs;
+            size_t rhs;
+            std::string labels; // batch labels, then free labels of lhs, then free labels of rhs
+        };
+
+        std::vector<std::string> inputs;    // subscripts of each operand as written
+        std::vector<std::string> reduced;   // labels of each operand after folding repeated labels and summing private ones
+        std::string output;
+        std::vector<step> steps;
+        double cost{0};                     // multiply-adds of all steps
+    };
+
+}
+
+namespace test::detail{
+
+    inline size_t einsum_label(char c){
+        if( c >= 'a' && c <= 'z' ) return size_t(c - 'a');
+        if( c >= 'A' && c <= 'Z' ) return size_t(c - 'A') + 26u;
+        throw std::invalid_argument("Error in einsum() : subscripts must be letters");
+    }
+
+    using einsum_mask = std::uint64_t;
+
+    inline einsum_mask einsum_labels_mask(std::string const& s){
+        auto m = einsum_mask{0};
+        for(auto c : s){
+            m |= einsum_mask{1} << einsum_label(c);
+        }
+        return m;
+    }
+
+    /** @brief Labels of s in order of first appearance */
+    inline std::string einsum_unique(std::string const& s){
+        auto r = std::string{};
+        for(auto c : s){
+            if( r.find(c) == std::string::npos ){
+                r.push_back(c);
+            }
+        }
+        return r;
+    }
+
+    /** @brief Labels of s that are in mask, in the order of s */
+    inline std::string einsum_select(std::string const& s, einsum_mask mask){
+        auto r = std::string{};
+        for(auto c : s){
+            if( mask & ( einsum_mask{1} << einsum_label(c) ) ){
+                r.push_back(c);
+            }
+        }
+        return r;
+    }
+
+    /** @brief Labels of lhs and rhs that survive a pairwise step, in batch, lhs free, rhs free order */
+    inline std::string einsum_step_labels(std::string const& lhs, std::string const& rhs, einsum_mask keep){
+        auto const ml = einsum_labels_mask(lhs);
+        auto const mr = einsum_labels_mask(rhs);
+        return einsum_select(lhs, keep & ml & mr) + einsum_select(lhs, keep & ml & ~mr) + einsum_select(rhs, keep & mr & ~ml);
+    }
+
+    /** @brief Greedy order: repeatedly contracts the pair with the fewest multiply-adds */
+    inline std::vector<std::pair<size_t,size_t>> einsum_greedy(std::vector<einsum_mask> live, einsum_mask out,
+                                                               std::array<double,52> const& ext)
+    {
+        auto volume = [&](einsum_mask m){
+            auto v = 1.0;
+            for(auto l = size_t{0}; l < 52u; l++){
+                if( m & ( einsum_mask{1} << l ) ) v *= ext[l];
+            }
+            return v;
+        };
+
+        auto ids = std::vector<size_t>(live.size());
+        for(auto i = size_t{0}; i < ids.size(); i++){
+            ids[i] = i;
+        }
+
+        auto pairs = std::vector<std::pair<size_t,size_t>>{};
+        auto next = live.size();
+        while( live.size() > 1u ){
+            auto best = std::make_pair(size_t{0}, size_t{1});
+            auto best_cost = std::numeric_limits<double>::infinity();
+            auto best_size = best_cost;
+            for(auto i = size_t{0}; i < live.size(); i++){
+                for(auto j = i + 1; j < live.size(); j++){
+                    auto rest = out;
+                    for(auto o = size_t{0}; o < live.size(); o++){
+                        if( o != i && o != j ) rest |= live[o];
+                    }
+                    auto const cost = volume(live[i] | live[j]);
+                    auto const size = volume( ( live[i] | live[j] ) & rest );
+                    if( cost < best_cost || ( cost == best_cost && size < best_size ) ){
+                        best = {i, j};
+                        best_cost = cost;
+                        best_size = size;
+                    }
+                }
+            }
+            auto rest = out;
+            for(auto o = size_t{0}; o < live.size(); o++){
+                if( o != best.first && o != best.second ) rest |= live[o];
+            }
+            pairs.emplace_back(ids[best.first], ids[best.second]);
+            live[best.first] = ( live[best.first] | live[best.second] ) & rest;
+            ids[best.first] = next++;
+            live.erase(live.begin() + ptrdiff_t(best.second));
+            ids.erase(ids.begin() + ptrdiff_t(best.second));
+        }
+        return pairs;
+    }
+
+    /** @brief Exact order by dynamic programming over operand subsets, 3^n work */
+    inline std::vector<std::pair<size_t,size_t>> einsum_optimal(std::vector<einsum_mask> const& in, einsum_mask out,
+                                                                std::array<double,52> const& ext)
+    {
+        auto volume = [&](einsum_mask m){
+            auto v = 1.0;
+            for(auto l = size_t{0}; l < 52u; l++){
+                if( m & ( einsum_mask{1} << l ) ) v *= ext[l];
+            }
+            return v;
+        };
+
+        auto const n = in.size();
+        auto const full = ( size_t{1} << n ) - 1u;
+        auto labels = std::vector<einsum_mask>(full + 1u, 0);
+        for(auto s = size_t{1}; s <= full; s++){
+            for(auto i = size_t{0}; i < n; i++){
+                if( s & ( size_t{1} << i ) ) labels[s] |= in[i];
+            }
+        }
+        // labels left after contracting the subset s into one operand
+        auto result = [&](size_t s){
+            return labels[s] & ( out | labels[full & ~s] );
+        };
+
+        auto cost = std::vector<double>(full + 1u, std::numeric_limits<double>::infinity());
+        auto split = std::vector<size_t>(full + 1u, 0);
+        for(auto s = size_t{1}; s <= full; s++){
+            if( ( s & ( s - 1u ) ) == 0u ){
+                cost[s] = 0;
+                continue;
+            }
+            auto const lowest = s & ( ~s + 1u );
+            // enumerate splits once by keeping the lowest operand in the left part
+            for(auto l = ( s - 1u ) & s; l > 0u; l = ( l - 1u ) & s){
+                if( !( l & lowest ) ) continue;
+                auto const r = s & ~l;
+                auto const c = cost[l] + cost[r] + volume( result(l) | result(r) );
+                if( c < cost[s] ){
+                    cost[s] = c;
+                    split[s] = l;
+                }
+            }
+        }
+
+        auto pairs = std::vector<std::pair<size_t,size_t>>{};
+        auto next = n;
+        auto emit = [&](auto& self, size_t s) -> size_t{
+            if( ( s & ( s - 1u ) ) == 0u ){
+                auto i = size_t{0};
+                while( !( s & ( size_t{1} << i ) ) ) i++;
+                return i;
+            }
+            auto const l = self(self, split[s]);
+            auto const r = self(self, s & ~split[s]);
+            pairs.emplace_back(l, r);
+            return next++;
+        };
+        emit(emit, full);
+        return pairs;
+    }
+
+    /** @brief Operand count up to which the contraction order is searched exhaustively */
+    constexpr size_t einsum_optimal_limit = 8;
+
+}
+
+namespace test{
+
+    /** @brief Parses subscripts and chooses a pairwise contraction order for operands of the given shapes
+     *
+     * Subscripts follow numpy: one letter per mode, operands separated by commas and an optional
+     * "->" output; without it the output holds the labels occurring exactly once, sorted. A label
+     * repeated within an operand takes its diagonal. Labels private to one operand and absent from
+     * the output are summed out before any pairwise step. Orders of up to einsum_optimal_limit
+     * operands are searched exhaustively, longer ones greedily, minimizing multiply-adds.
+     *
+     * @code auto p = make_einsum_plan( "ijk,kl,lm->ijm", { {8,8,64}, {64,2}, {2,512} } );
+     *
+     * @note the plan is independent of the value type
+     */
+    inline einsum_plan make_einsum_plan(std::string const& subscripts, std::vector<std::vector<ptrdiff_t>> const& shapes){
+        auto s = std::string{};
+        for(auto c : subscripts){
+            if( c != ' ' ) s.push_back(c);
+        }
+
+        auto plan = einsum_plan{};
+        auto const arrow = s.find("->");
+        auto const lhs = s.substr(0, arrow);
+        for(auto b = size_t{0};;){
+            auto const e = lhs.find(',', b);
+            plan.inputs.push_back( lhs.substr(b, e - b) );
+            if( e == std::string::npos ) break;
+            b = e + 1u;
+        }
+        if( plan.inputs.size() != shapes.size() ){
+            throw std::invalid_argument("Error in einsum() : number of subscripts and operands differ");
+        }
+
+        auto ext = std::array<double,52>{};
+        auto extent = std::array<ptrdiff_t,52>{};
+        auto count = std::array<size_t,52>{};
+        for(auto i = size_t{0}; i < shapes.size(); i++){
+            auto const& in = plan.inputs[i];
+            if( in.size() != shapes[i].size() ){
+                throw std::length_error("Error in einsum() : number of subscripts and rank of operand differ");
+            }
+            for(auto k = size_t{0}; k < in.size(); k++){
+                auto const l = detail::einsum_label(in[k]);
+                if( extent[l] != 0 && extent[l] != shapes[i][k] ){
+                    throw std::length_error("Error in einsum() : extents of one label differ");
+                }
+                extent[l] = shapes[i][k];
+                ext[l] = double(shapes[i][k]);
+                count[l]++;
+            }
+        }
+
+        if( arrow == std::string::npos ){
+            for(auto l = size_t{0}; l < 52u; l++){
+                if( count[l] == 1u ) plan.output.push_back( char( l < 26u ? 'a' + l : 'A' + ( l - 26u ) ) );
+            }
+            std::sort(plan.output.begin(), plan.output.end());
+        }else{
+            plan.output = s.substr(arrow + 2u);
+            for(auto c : plan.output){
+                if( count[detail::einsum_label(c)] == 0u ){
+                    throw std::invalid_argument("Error in einsum() : output label not in any operand");
+                }
+            }
+            if( detail::einsum_unique(plan.output).size() != plan.output.size() ){
+                throw std::invalid_argument("Error in einsum() : repeated output label");
+            }
+        }
+
+        auto const n = plan.inputs.size();
+        auto const out = detail::einsum_labels_mask(plan.output);
+        auto masks = std::vector<detail::einsum_mask>(n);
+        for(auto i = size_t{0}; i < n; i++){
+            auto others = out;
+            for(auto j = size_t{0}; j < n; j++){
+                if( j != i ) others |= detail::einsum_labels_mask(plan.inputs[j]);
+            }
+            plan.reduced.push_back( detail::einsum_select( detail::einsum_unique(plan.inputs[i]), others ) );
+            masks[i] = detail::einsum_labels_mask(plan.reduced[i]);
+        }
+
+        auto const pairs = n <= detail::einsum_optimal_limit ? detail::einsum_optimal(masks, out, ext)
+                                                             : detail::einsum_greedy(masks, out, ext);
+
+        auto labels = plan.reduced;
+        auto live = std::vector<bool>(n, true);
+        for(auto const& [l, r] : pairs){
+            live[l] = live[r] = false;
+            auto keep = out;
+            for(auto i = size_t{0}; i < labels.size(); i++){
+                if( live[i] ) keep |= detail::einsum_labels_mask(labels[i]);
+            }
+            auto v = 1.0;
+            for(auto c : detail::einsum_unique(labels[l] + labels[r])){
+                v *= ext[detail::einsum_label(c)];
+            }
+            plan.cost += v;
+            plan.steps.push_back({ l, r, detail::einsum_step_labels(labels[l], labels[r], keep) });
+            labels.push_back(plan.steps.back().labels);
+            live.push_back(true);
+        }
+        return plan;
+    }
+
+}
+
+namespace test::detail{
+
+    /** @brief Free list of intermediate buffers, reused best-fit so repeated evaluations stop allocating */
+    template< typename T >
+    struct buffer_pool{
+        using buffer_type = storage_type::dense_tensor::uninitialized_vector<T>;
+
+        static constexpr size_t max_buffers = 4;
+
+        buffer_type acquire(size_t n){
+            auto best = _free.end();
+            for(auto it = _free.begin(); it != _free.end(); ++it){
+                if( it->capacity() >= n && ( best == _free.end() || it->capacity() < best->capacity() ) ){
+                    best = it;
+                }
+            }
+            if( best == _free.end() ){
+                return buffer_type(n);
+            }
+            auto b = std::move(*best);
+            _free.erase(best);
+            b.resize(n);
+            return b;
+        }
+
+        void release(buffer_type&& b){
+            if( b.capacity() == 0u ){
+                return;
+            }
+            b.clear();
+            if( _free.size() == max_buffers ){
+                auto smallest = std::min_element(_free.begin(), _free.end(), [](auto const& x, auto const& y){
+                    return x.capacity() < y.capacity();
+                });
+                if( smallest->capacity() >= b.capacity() ){
+                    return;
+                }
+                _free.erase(smallest);
+            }
+            _free.push_back(std::move(b));
+        }
+
+    private:
+        std::vector<buffer_type> _free;
+    };
+
+    template< typename T >
+    buffer_pool<T>& einsum_pool(){
+        static thread_local buffer_pool<T> pool;
+        return pool;
+    }
+
+    /** @brief Strided view of an einsum operand, owning its buffer if it is an intermediate */
+    template< typename T >
+    struct einsum_operand{
+        T const* data;
+        std::string labels;
+        std::vector<ptrdiff_t> e;
+        std::vector<ptrdiff_t> s;
+        typename buffer_pool<T>::buffer_type buffer;
+    };
+
+    /** @brief Row-major operand over a pooled buffer */
+    template< typename T >
+    einsum_operand<T> einsum_intermediate(std::string labels, std::vector<ptrdiff_t> e){
+        auto n = size_t{1};
+        for(auto x : e) n *= size_t(x);
+        auto op = einsum_operand<T>{ nullptr, std::move(labels), std::move(e), {}, einsum_pool<T>().acquire(n) };
+        op.s = std::vector<ptrdiff_t>(op.e.size());
+        auto acc = ptrdiff_t{1};
+        for(auto k = op.s.size(); k-- > 0u;){
+            op.s[k] = acc;
+            acc *= op.e[k];
+        }
+        op.data = op.buffer.data();
+        return op;
+    }
+
+    /** @brief Folds repeated labels of an operand into one mode whose stride is the sum of theirs */
+    template< typename T >
+    einsum_operand<T> einsum_fold(T const* data, std::string const& labels, std::vector<ptrdiff_t> const& e, std::vector<ptrdiff_t> const& s){
+        auto op = einsum_operand<T>{ data, {}, {}, {}, {} };
+        for(auto k = size_t{0}; k < labels.size(); k++){
+            auto const at = op.labels.find(labels[k]);
+            if( at == std::string::npos ){
+                op.labels.push_back(labels[k]);
+                op.e.push_back(e[k]);
+                op.s.push_back(s[k]);
+            }else{
+                op.s[at] += s[k];
+            }
+        }
+        return op;
+    }
+
+    inline std::vector<size_t> einsum_modes(std::string const& of, std::string const& labels){
+        auto m = std::vector<size_t>{};
+        for(auto c : labels){
+            m.push_back( of.find(c) );
+        }
+        return m;
+    }
+
+    /** @brief Sums src over its labels not in keep, writing keep (row-major) into dst */
+    template< typename T >
+    void einsum_reduce(einsum_operand<T> const& src, std::string const& keep, T* dst){
+        auto const r = src.labels.size();
+        auto ds = std::vector<ptrdiff_t>(r, 0);
+        auto n = size_t{1};
+        for(auto k = keep.size(); k-- > 0u;){
+            ds[ src.labels.find(keep[k]) ] = ptrdiff_t(n);
+            n *= size_t( src.e[ src.labels.find(keep[k]) ] );
+        }
+        std::fill(dst, dst + n, T{});
+        if( r == 0u ){
+            *dst = *src.data;
+            return;
+        }
+
+        auto timer = instrumentation::scoped_kernel("einsum_reduce", n * sizeof(T));
+        auto idx = std::vector<ptrdiff_t>(r, 0);
+        auto const inner_n = src.e[r - 1u];
+        auto const inner_s = src.s[r - 1u];
+        auto const inner_d = ds[r - 1u];
+        for(;;){
+            auto so = ptrdiff_t{0};
+            auto doff = ptrdiff_t{0};
+            for(auto i = size_t{0}; i + 1u < r; i++){
+                so += idx[i] * src.s[i];
+                doff += idx[i] * ds[i];
+            }
+            for(auto j = ptrdiff_t{0}; j < inner_n; j++){
+                dst[doff + j * inner_d] += src.data[so + j * inner_s];
+            }
+            auto i = r - 1u;
+            while( i-- > 0u ){
+                if( ++idx[i] < src.e[i] ) break;
+                idx[i] = 0;
+            }
+            if( i == size_t(-1) ) return;
+        }
+    }
+
+    /** @brief Permutes the modes of op into contiguous row-major order perm */
+    template< typename T >
+    einsum_operand<T> einsum_permute(einsum_operand<T>&& op, std::vector<size_t> const& perm){
+        auto labels = std::string{};
+        auto e = std::vector<ptrdiff_t>{};
+        for(auto m : perm){
+            labels.push_back(op.labels[m]);
+            e.push_back(op.e[m]);
+        }
+        auto r = einsum_intermediate<T>(std::move(labels), std::move(e));
+        auto timer = instrumentation::scoped_kernel("permute", 2u * r.buffer.size() * sizeof(T));
+        permute_copy(op.data, op.e, op.s, perm, r.buffer.data());
+        einsum_pool<T>().release(std::move(op.buffer));
+        return r;
+    }
+
+    /** @brief Contracts x with y into dst, laid out row-major as labels (batch, x free, y free)
+     *
+     * Every batch index is one gemm on strided matrix views of x and y; an operand is permuted to
+     * [batch, free, contracted] order only if its free or contracted labels do not merge into one stride.
+     * Products too small to amortize gemm's packing use a direct loop.
+     */
+    template< typename T >
+    void einsum_pair(einsum_operand<T> x, einsum_operand<T> y, std::string const& labels, T* dst){
+        auto const mx = einsum_labels_mask(x.labels);
+        auto const my = einsum_labels_mask(y.labels);
+        auto const keep = einsum_labels_mask(labels);
+        auto const batch = einsum_select(labels, mx & my);
+        auto const fx = einsum_select(labels, mx & ~my);
+        auto const fy = einsum_select(labels, my & ~mx);
+        auto const con = einsum_select(x.labels, mx & my & ~keep);
+
+        if( merged_stride(x.e, x.s, einsum_modes(x.labels, fx)) == -1 || merged_stride(x.e, x.s, einsum_modes(x.labels, con)) == -1 ){
+            x = einsum_permute( std::move(x), einsum_modes(x.labels, batch + fx + con) );
+        }
+        if( merged_stride(y.e, y.s, einsum_modes(y.labels, con)) == -1 || merged_stride(y.e, y.s, einsum_modes(y.labels, fy)) == -1 ){
+            y = einsum_permute( std::move(y), einsum_modes(y.labels, batch + con + fy) );
+        }
+
+        auto prod = [](einsum_operand<T> const& op, std::string const& g){
+            auto p = size_t{1};
+            for(auto c : g) p *= size_t( op.e[ op.labels.find(c) ] );
+            return p;
+        };
+        auto const m = prod(x, fx);
+        auto const n = prod(y, fy);
+        auto const k = prod(x, con);
+        auto const rsx = merged_stride(x.e, x.s, einsum_modes(x.labels, fx));
+        auto const csx = merged_stride(x.e, x.s, einsum_modes(x.labels, con));
+        auto const rsy = merged_stride(y.e, y.s, einsum_modes(y.labels, con));
+        auto const csy = merged_stride(y.e, y.s, einsum_modes(y.labels, fy));
+
+        auto const bx = einsum_modes(x.labels, batch);
+        auto const by = einsum_modes(y.labels, batch);
+        auto idx = std::vector<ptrdiff_t>(batch.size(), 0);
+        auto const small = m * n * k < 4096u;
+
+        for(auto* c = dst;; c += m * n){
+            auto ox = ptrdiff_t{0};
+            auto oy = ptrdiff_t{0};
+            for(auto i = size_t{0}; i < batch.size(); i++){
+                ox += idx[i] * x.s[bx[i]];
+                oy += idx[i] * y.s[by[i]];
+            }
+            auto const* a = x.data + ox;
+            auto const* b = y.data + oy;
+            if( small ){
+                for(auto i = size_t{0}; i < m; i++){
+                    for(auto j = size_t{0}; j < n; j++){
+                        auto acc = T{};
+                        for(auto p = size_t{0}; p < k; p++){
+                            acc += a[ ptrdiff_t(i) * rsx + ptrdiff_t(p) * csx ] * b[ ptrdiff_t(p) * rsy + ptrdiff_t(j) * csy ];
+                        }
+                        c[i * n + j] = acc;
+                    }
+                }
+            }else{
+                gemm( m, n, k, T{1}, a, rsx, csx, b, rsy, csy, T{0}, c, ptrdiff_t(n), ptrdiff_t{1} );
+            }
+
+            auto i = batch.size();
+            while( i-- > 0u ){
+                if( ++idx[i] < x.e[bx[i]] ) break;
+                idx[i] = 0;
+            }
+            if( i == size_t(-1) ) break;
+        }
+
+        einsum_pool<T>().release(std::move(x.buffer));
+        einsum_pool<T>().release(std::move(y.buffer));
+    }
+
+    /** @brief Plans kept by the plan cache; beyond that the least recently used plan is dropped */
+    constexpr size_t einsum_plan_cache_capacity = 256;
+
+    /** @brief Least recently used cache of einsum plans, most recent at the front of order */
+    struct einsum_plan_cache{
+        using entry = std::pair< std::string, std::shared_ptr<einsum_plan const> >;
+
+        std::mutex mutex;
+        std::list<entry> order;
+        std::unordered_map< std::string, std::list<entry>::iterator > plans;
+
+        /** @brief Returns the plan of key and marks it most recently used, or nullptr */
+        std::shared_ptr<einsum_plan const> find(std::string const& key){
+            auto const it = plans.find(key);
+            if( it == plans.end() ){
+                return nullptr;
+            }
+            order.splice(order.begin(), order, it->second);
+            return it->second->second;
+        }
+
+        /** @brief Inserts plan under key unless another thread did first, evicting beyond the capacity */
+        std::shared_ptr<einsum_plan const> insert(std::string key, std::shared_ptr<einsum_plan const> plan){
+            if( auto p = find(key) ){
+                return p;
+            }
+            order.emplace_front( std::move(key), std::move(plan) );
+            plans.emplace( order.front().first, order.begin() );
+            while( plans.size() > einsum_plan_cache_capacity ){
+                plans.erase( order.back().first );
+                order.pop_back();
+            }
+            return order.front().second;
+        }
+
+        void clear(){
+            plans.clear();
+            order.clear();
+        }
+    };
+
+    inline einsum_plan_cache& plan_cache(){
+        static einsum_plan_cache cache;
+        return cache;
+    }
+
+    /** @brief Plan for subscripts and shapes, computed once per distinct pair and shared by all threads
+     *
+     * At most einsum_plan_cache_capacity plans are kept, so varying dynamic shapes do not grow the
+     * cache without bound.
+     */
+    inline std::shared_ptr<einsum_plan const> cached_einsum_plan(std::string const& subscripts, std::vector<std::vector<ptrdiff_t>> const& shapes){
+        auto key = subscripts;
+        for(auto const& sh : shapes){
+            key.push_back('|');
+            for(auto x : sh){
+                key += std::to_string(x);
+                key.push_back(',');
+            }
+        }
+
+        auto& cache = plan_cache();
+        {
+            auto lock = std::lock_guard<std::mutex>(cache.mutex);
+            if( auto p = cache.find(key) ){
+                return p;
+            }
+        }
+        auto plan = std::make_shared<einsum_plan const>( make_einsum_plan(subscripts, shapes) );
+        auto lock = std::lock_guard<std::mutex>(cache.mutex);
+        return cache.insert( std::move(key), std::move(plan) );
+    }
+
+}
+
+namespace test{
+
+    /** @brief Drops every cached einsum plan */
+    inline void einsum_clear_cache(){
+        auto& cache = detail::plan_cache();
+        auto lock = std::lock_guard<std::mutex>(cache.mutex);
+        cache.clear();
+    }
+
+    /** @brief Number of cached einsum plans, at most detail::einsum_plan_cache_capacity */
+    inline size_t einsum_cached_plans(){
+        auto& cache = detail::plan_cache();
+        auto lock = std::lock_guard<std::mutex>(cache.mutex);
+        return cache.plans.size();
+    }
+
+    /** @brief Evaluates an einsum expression over dense tensors
+     *
+     * The plan (see make_einsum_plan) is cached by subscripts and operand shapes in a small LRU
+     * cache, so repeated evaluations skip parsing and planning; intermediates come from a per-thread buffer pool.
+     * Each pairwise step is a batched transpose-GEMM-transpose as in test::contract.
+     *
+     * @code auto d = einsum( "ijk,kl,lm->ijm", a, b, c );
+     *
+     * @note a scalar result has extents {1}
+     *
+     * @param subscripts numpy-style subscripts, letters only
+     * @param ts dense tensors of one value type
+     */
+    template< typename T, typename E, typename F, typename A, typename ... Ts >
+    auto einsum(std::string const& subscripts, tensor<T,E,F,A> const& t, Ts const& ... ts){
+        static_assert( ( std::is_same_v<T, typename Ts::value_type> && ... ), "einsum requires operands of one value type" );
+
+        auto const shapes = std::vector<std::vector<ptrdiff_t>>{ to_dynamic(t.extents()).base(), to_dynamic(ts.extents()).base()... };
+        auto const plan = detail::cached_einsum_plan(subscripts, shapes);
+
+        auto bytes = t.size() * sizeof(T);
+        ( ( bytes += ts.size() * sizeof(T) ), ... );
+        auto timer = instrumentation::scoped_kernel("einsum", bytes);
+
+        auto const data = std::vector<T const*>{ t.data(), ts.data()... };
+        auto ops = std::vector<detail::einsum_operand<T>>{};
+        ops.reserve( data.size() + plan->steps.size() );
+        for(auto i = size_t{0}; i < data.size(); i++){
+            auto const s = row_major_strides( extents<dynamic_dims>( shapes[i].begin(), shapes[i].end() ) );
+            auto op = detail::einsum_fold(data[i], plan->inputs[i], shapes[i], s);
+            if( op.labels != plan->reduced[i] ){
+                auto e = std::vector<ptrdiff_t>{};
+                for(auto c : plan->reduced[i]) e.push_back( op.e[ op.labels.find(c) ] );
+                auto r = detail::einsum_intermediate<T>(plan->reduced[i], std::move(e));
+                detail::einsum_reduce(op, plan->reduced[i], r.buffer.data());
+                op = std::move(r);
+            }
+            ops.push_back(std::move(op));
+        }
+
+        auto extent = std::array<ptrdiff_t,52>{};
+        for(auto i = size_t{0}; i < shapes.size(); i++){
+            for(auto k = size_t{0}; k < shapes[i].size(); k++){
+                extent[ detail::einsum_label(plan->inputs[i][k]) ] = shapes[i][k];
+            }
+        }
+        auto out_e = std::vector<ptrdiff_t>{};
+        for(auto l : plan->output) out_e.push_back( extent[detail::einsum_label(l)] );
+        auto c = tensor<T, dims<dynamic_dims>>( out_e.empty() ? extents<dynamic_dims>{1} : extents<dynamic_dims>( out_e.begin(), out_e.end() ),
+                                                storage_type::uninitialized );
+
+        for(auto i = size_t{0}; i < plan->steps.size(); i++){
+            auto const& st = plan->steps[i];
+            auto e = std::vector<ptrdiff_t>{};
+            for(auto l : st.labels) e.push_back( extent[detail::einsum_label(l)] );
+            // the last step writes straight into the result when its layout already matches
+            auto const direct = i + 1u == plan->steps.size() && st.labels == plan->output;
+            auto r = direct ? detail::einsum_operand<T>{ c.data(), st.labels, std::move(e), {}, {} }
+                            : detail::einsum_intermediate<T>(st.labels, std::move(e));
+            detail::einsum_pair( std::move(ops[st.lhs]), std::move(ops[st.rhs]), st.labels, direct ? c.data() : r.buffer.data() );
+            ops.push_back(std::move(r));
+        }
+
+        auto& last = ops.back();
+        if( last.data != c.data() ){
+            detail::permute_copy( last.data, last.e, last.s, detail::einsum_modes(last.labels, plan->output), c.data() );
+        }
+        detail::einsum_pool<T>().release(std::move(last.buffer));
+        return c;
+    }
+
+}
+
+#endif // EINSUM_H
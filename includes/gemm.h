@@ -0,0 +1,285 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include "instrumentation.h"
+#include "storage_policy.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace test::detail{
+
+    /** @brief Register and cache blocking of gemm for value type T
+     *
+     * The micro-tile MR x NR is kept in local accumulators; NR spans 64 bytes so the inner
+     * update vectorizes to full-width fused multiply-adds. KC x NR panels of B stay in L1,
+     * MC x KC blocks of A in L2 and KC x NC panels of B in L3.
+     */
+    template< typename T >
+    struct gemm_blocking{
+        static constexpr size_t MR = 6;
+        static constexpr size_t NR = std::max<size_t>( 4, 64 / sizeof(T) );
+        static constexpr size_t KC = 256;
+        static constexpr size_t MC = 96;
+        static constexpr size_t NC = 2048;
+    };
+
+    /** @brief Packs the mc x kc block of A into MR-row micro-panels, zero padding the last one */
+    template< typename T >
+    void gemm_pack_a(size_t mc, size_t kc, T const* a, ptrdiff_t rs, ptrdiff_t cs, T* pa){
+        constexpr auto MR = gemm_blocking<T>::MR;
+        for(auto i0 = size_t{0}; i0 < mc; i0 += MR){
+            auto const mr = std::min(MR, mc - i0);
+            for(auto p = size_t{0}; p < kc; p++){
+                for(auto i = size_t{0}; i < mr; i++){
+                    pa[i] = a[ ptrdiff_t(i0 + i) * rs + ptrdiff_t(p) * cs ];
+                }
+                for(auto i = mr; i < MR; i++){
+                    pa[i] = T{};
+                }
+                pa += MR;
+            }
+        }
+    }
+
+    /** @brief Packs the kc x nc panel of B into NR-column micro-panels, zero padding the last one */
+    template< typename T >
+    void gemm_pack_b(size_t kc, size_t nc, T const* b, ptrdiff_t rs, ptrdiff_t cs, T* pb){
+        constexpr auto NR = gemm_blocking<T>::NR;
+        for(auto j0 = size_t{0}; j0 < nc; j0 += NR){
+            auto const nr = std::min(NR, nc - j0);
+            for(auto p = size_t{0}; p < kc; p++){
+                auto const* row = b + ptrdiff_t(p) * rs + ptrdiff_t(j0) * cs;
+                if( cs == 1 ){
+                    for(auto j = size_t{0}; j < nr; j++){
+                        pb[j] = row[j];
+                    }
+                }else{
+                    for(auto j = size_t{0}; j < nr; j++){
+                        pb[j] = row[ ptrdiff_t(j) * cs ];
+                    }
+                }
+                for(auto j = nr; j < NR; j++){
+                    pb[j] = T{};
+                }
+                pb += NR;
+            }
+        }
+    }
+
+#if defined(__GNUC__)
+    /** @brief One row of a micro-tile as a single vector register (or register pair) */
+    template< typename T >
+    struct gemm_row{
+        typedef T type __attribute__(( vector_size( gemm_blocking<T>::NR * sizeof(T) ) ));
+    };
+#endif
+
+    /** @brief C[0:mr, 0:nr] = alpha * pa * pb + beta * C for packed MR x kc and kc x NR micro-panels */
+    template< typename T >
+    void gemm_micro_kernel(size_t kc, T alpha, T const* pa, T const* pb, T beta, T* c, ptrdiff_t rs, ptrdiff_t cs, size_t mr, size_t nr){
+        constexpr auto MR = gemm_blocking<T>::MR;
+        constexpr auto NR = gemm_blocking<T>::NR;
+
+        T acc[MR][NR];
+#if defined(__GNUC__)
+        // explicit vectors keep the MR accumulators in registers for the whole k loop
+        using row = typename gemm_row<T>::type;
+        row r[MR] = {};
+        for(auto p = size_t{0}; p < kc; p++){
+            row b;
+            std::memcpy(&b, pb, sizeof(row));
+            for(auto i = size_t{0}; i < MR; i++){
+                r[i] += pa[i] * b;
+            }
+            pa += MR;
+            pb += NR;
+        }
+        std::memcpy(acc, r, sizeof(acc));
+#else
+        for(auto i = size_t{0}; i < MR; i++){
+            for(auto j = size_t{0}; j < NR; j++){
+                acc[i][j] = T{};
+            }
+        }
+        for(auto p = size_t{0}; p < kc; p++){
+            for(auto i = size_t{0}; i < MR; i++){
+                auto const ai = pa[i];
+                for(auto j = size_t{0}; j < NR; j++){
+                    acc[i][j] += ai * pb[j];
+                }
+            }
+            pa += MR;
+            pb += NR;
+        }
+#endif
+
+        for(auto i = size_t{0}; i < mr; i++){
+            auto* ci = c + ptrdiff_t(i) * rs;
+            for(auto j = size_t{0}; j < nr; j++){
+                auto& cij = ci[ ptrdiff_t(j) * cs ];
+                cij = beta == T{} ? alpha * acc[i][j] : alpha * acc[i][j] + beta * cij;
+            }
+        }
+    }
+
+    /** @brief sum_i x[i * incx] * y[i * incy]
+     *
+     * Four independent accumulators break the dependency chain of the sum so the unit-stride loop
+     * vectorizes; the result differs from a sequential sum by rounding only.
+     */
+    template< typename T >
+    T dot_kernel(size_t n, T const* x, ptrdiff_t incx, T const* y, ptrdiff_t incy){
+        T acc[4] = {};
+        auto i = size_t{0};
+        if( incx == 1 && incy == 1 ){
+            for(; i + 4 <= n; i += 4){
+                acc[0] += x[i] * y[i];
+                acc[1] += x[i + 1] * y[i + 1];
+                acc[2] += x[i + 2] * y[i + 2];
+                acc[3] += x[i + 3] * y[i + 3];
+            }
+        }
+        for(; i < n; i++){
+            acc[0] += x[ ptrdiff_t(i) * incx ] * y[ ptrdiff_t(i) * incy ];
+        }
+        return ( acc[0] + acc[1] ) + ( acc[2] + acc[3] );
+    }
+
+    template< typename T >
+    void axpy_kernel(size_t n, T alpha, T const* x, ptrdiff_t incx, T* y, ptrdiff_t incy){
+        if( incx == 1 && incy == 1 ){
+            for(auto i = size_t{0}; i < n; i++){
+                y[i] += alpha * x[i];
+            }
+            return;
+        }
+        for(auto i = size_t{0}; i < n; i++){
+            y[ ptrdiff_t(i) * incy ] += alpha * x[ ptrdiff_t(i) * incx ];
+        }
+    }
+
+}
+
+namespace test{
+
+    /** @brief General matrix multiply C = alpha * A * B + beta * C on strided operands
+     *
+     * A is m x k, B is k x n and C is m x n; element (i,j) of a matrix X is X[i * rsx + j * csx],
+     * so row-major, column-major, transposed and tensor-unfolding views are all accepted without
+     * copies beyond the packing of cache blocks. Built in, no BLAS dependency.
+     *
+     * @code gemm( m, n, k, 1.f, a, k, 1, b, n, 1, 0.f, c, n, 1 ); // row-major
+     *
+     * @note when beta is zero C is not read
+     */
+    template< typename T >
+    void gemm(size_t m, size_t n, size_t k,
+              T alpha, T const* a, ptrdiff_t rsa, ptrdiff_t csa,
+                       T const* b, ptrdiff_t rsb, ptrdiff_t csb,
+              T beta,  T* c, ptrdiff_t rsc, ptrdiff_t csc)
+    {
+        using blocking = detail::gemm_blocking<T>;
+        constexpr auto MR = blocking::MR, NR = blocking::NR;
+        constexpr auto MC = blocking::MC, KC = blocking::KC, NC = blocking::NC;
+
+        if( m == 0 || n == 0 ){
+            return;
+        }
+
+        auto timer = instrumentation::scoped_kernel("gemm", ( m * k + k * n + m * n ) * sizeof(T));
+
+        if( k == 0 ){
+            for(auto i = size_t{0}; i < m; i++){
+                for(auto j = size_t{0}; j < n; j++){
+                    auto& cij = c[ ptrdiff_t(i) * rsc + ptrdiff_t(j) * csc ];
+                    cij = beta == T{} ? T{} : beta * cij;
+                }
+            }
+            return;
+        }
+
+        auto pa = storage_type::dense_tensor::uninitialized_vector<T>( ( std::min(MC, m) + MR - 1 ) / MR * MR * std::min(KC, k) );
+        auto pb = storage_type::dense_tensor::uninitialized_vector<T>( ( std::min(NC, n) + NR - 1 ) / NR * NR * std::min(KC, k) );
+
+        for(auto jc = size_t{0}; jc < n; jc += NC){
+            auto const nc = std::min(NC, n - jc);
+            for(auto pc = size_t{0}; pc < k; pc += KC){
+                auto const kc = std::min(KC, k - pc);
+                // later k-blocks accumulate onto the first one
+                auto const beta_c = pc == 0 ? beta : T{1};
+
+                detail::gemm_pack_b( kc, nc, b + ptrdiff_t(pc) * rsb + ptrdiff_t(jc) * csb, rsb, csb, pb.data() );
+
+                for(auto ic = size_t{0}; ic < m; ic += MC){
+                    auto const mc = std::min(MC, m - ic);
+                    detail::gemm_pack_a( mc, kc, a + ptrdiff_t(ic) * rsa + ptrdiff_t(pc) * csa, rsa, csa, pa.data() );
+
+                    for(auto jr = size_t{0}; jr < nc; jr += NR){
+                        for(auto ir = size_t{0}; ir < mc; ir += MR){
+                            detail::gemm_micro_kernel( kc, alpha, pa.data() + ir * kc, pb.data() + jr * kc, beta_c,
+                                c + ptrdiff_t(ic + ir) * rsc + ptrdiff_t(jc + jr) * csc, rsc, csc,
+                                std::min(MR, mc - ir), std::min(NR, nc - jr) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /** @brief Returns sum_i x[i * incx] * y[i * incy], see detail::dot_kernel */
+    template< typename T >
+    T dot(size_t n, T const* x, ptrdiff_t incx, T const* y, ptrdiff_t incy){
+        auto timer = instrumentation::scoped_kernel("dot", 2 * n * sizeof(T));
+        return detail::dot_kernel(n, x, incx, y, incy);
+    }
+
+    /** @brief y[i * incy] += alpha * x[i * incx] for i in [0, n) */
+    template< typename T >
+    void axpy(size_t n, T alpha, T const* x, ptrdiff_t incx, T* y, ptrdiff_t incy){
+        auto timer = instrumentation::scoped_kernel("axpy", 3 * n * sizeof(T));
+        detail::axpy_kernel(n, alpha, x, incx, y, incy);
+    }
+
+    /** @brief y = alpha * A * x + beta * y with the strided m x n matrix A
+     *
+     * A row-major A (csa == 1) is traversed as m dot products, any other A as n column updates,
+     * so the inner loop runs along the unit stride whenever there is one.
+     *
+     * @note when beta is zero y is not read
+     */
+    template< typename T >
+    void gemv(size_t m, size_t n, T alpha, T const* a, ptrdiff_t rsa, ptrdiff_t csa,
+              T const* x, ptrdiff_t incx, T beta, T* y, ptrdiff_t incy)
+    {
+        auto timer = instrumentation::scoped_kernel("gemv", ( m * n + m + n ) * sizeof(T));
+        if( csa == 1 && rsa != 1 ){
+            for(auto i = size_t{0}; i < m; i++){
+                auto& yi = y[ ptrdiff_t(i) * incy ];
+                auto const d = detail::dot_kernel(n, a + ptrdiff_t(i) * rsa, ptrdiff_t{1}, x, incx);
+                yi = beta == T{} ? alpha * d : alpha * d + beta * yi;
+            }
+            return;
+        }
+        for(auto i = size_t{0}; i < m; i++){
+            auto& yi = y[ ptrdiff_t(i) * incy ];
+            yi = beta == T{} ? T{} : beta * yi;
+        }
+        for(auto j = size_t{0}; j < n; j++){
+            detail::axpy_kernel(m, alpha * x[ ptrdiff_t(j) * incx ], a + ptrdiff_t(j) * csa, rsa, y, incy);
+        }
+    }
+
+    /** @brief A += alpha * x * y^T for the strided m x n matrix A, the rank-1 update */
+    template< typename T >
+    void ger(size_t m, size_t n, T alpha, T const* x, ptrdiff_t incx, T const* y, ptrdiff_t incy,
+             T* a, ptrdiff_t rsa, ptrdiff_t csa)
+    {
+        auto timer = instrumentation::scoped_kernel("ger", ( 2 * m * n + m + n ) * sizeof(T));
+        for(auto i = size_t{0}; i < m; i++){
+            detail::axpy_kernel(n, alpha * x[ ptrdiff_t(i) * incx ], y, incy, a + ptrdiff_t(i) * rsa, csa);
+        }
+    }
+}
+
+#endif // GEMM_H
@@ -0,0 +1,259 @@
+#ifndef INDEX_MAPPING_H
+#define INDEX_MAPPING_H
+
+#include "mdspan.h"
+#include <array>
+#include <cstdint>
+#include <utility>
+
+namespace mdspan::detail{
+
+    /** @brief Unsigned division by a runtime-invariant divisor using a precomputed reciprocal
+     *
+     * Implements the round-up variant of Granlund-Montgomery: for a divisor d with
+     * l = ceil(log2(d)) and numerators n < 2^Bits, q = (m * n) >> (Bits + l) where
+     * m = ceil(2^(Bits + l) / d). The multiplier always fits in Bits + 1 bits, so the
+     * 32-bit variant only needs a 32x32->64 multiply and vectorizes, the 64-bit variant
+     * needs a 64x64->128 multiply.
+     *
+     * @note d must be > 0 and numerators must be < 2^Bits
+     */
+    template< unsigned Bits >
+    struct fast_divisor;
+
+    template<>
+    struct fast_divisor<31>{
+        using value_type = std::uint32_t;
+
+        constexpr fast_divisor() noexcept = default;
+
+        explicit constexpr fast_divisor(value_type d) noexcept
+            : _d(d), _shift(31 + ceil_log2(d)),
+              _magic( static_cast<value_type>( ( ( std::uint64_t{1} << _shift ) + d - 1 ) / d ) )
+        {
+        }
+
+        constexpr value_type divide(value_type n) const noexcept{
+            return static_cast<value_type>( ( std::uint64_t{_magic} * n ) >> _shift );
+        }
+
+        constexpr value_type divisor() const noexcept{ return _d; }
+
+    private:
+        static constexpr unsigned ceil_log2(value_type d) noexcept{
+            unsigned l = 0;
+            while( ( value_type{1} << l ) < d ) ++l;
+            return l;
+        }
+
+        value_type _d{1};
+        unsigned _shift{31};
+        value_type _magic{value_type{1} << 31};
+    };
+
+    template<>
+    struct fast_divisor<63>{
+        using value_type = std::uint64_t;
+
+        constexpr fast_divisor() noexcept = default;
+
+        explicit constexpr fast_divisor(value_type d) noexcept
+            : _d(d), _shift(63 + ceil_log2(d))
+        {
+#ifdef __SIZEOF_INT128__
+            _magic = static_cast<value_type>( ( ( static_cast<unsigned __int128>(1) << _shift ) + d - 1 ) / d );
+#endif
+        }
+
+        constexpr value_type divide(value_type n) const noexcept{
+#ifdef __SIZEOF_INT128__
+            return static_cast<value_type>( ( static_cast<unsigned __int128>(_magic) * n ) >> _shift );
+#else
+            return n / _d;
+#endif
+        }
+
+        constexpr value_type divisor() const noexcept{ return _d; }
+
+    private:
+        static constexpr unsigned ceil_log2(value_type d) noexcept{
+            unsigned l = 0;
+            while( l < 63 && ( value_type{1} << l ) < d ) ++l;
+            return l;
+        }
+
+        value_type _d{1};
+        unsigned _shift{63};
+        value_type _magic{value_type{1} << 63};
+    };
+
+    template< typename E >
+    constexpr bool is_dynamic_rank_v = std::is_same_v< E, extents<dynamic_dims> >;
+
+    template< typename E, typename T, typename = void >
+    struct rank_array{
+        using type = std::vector<T>;
+        static type make(E const& e){ return type(e.rank()); }
+    };
+
+    template< typename E, typename T >
+    struct rank_array< E, T, std::enable_if_t< !is_dynamic_rank_v<E> > >{
+        using type = std::array<T, static_cast<size_t>(E::rank())>;
+        static constexpr type make(E const&){ return type{}; }
+    };
+
+    /** @brief Array of one element per mode; std::array for static rank, std::vector for extents<dynamic_dims> */
+    template< typename E, typename T >
+    using rank_array_t = typename rank_array<E,T>::type;
+
+}
+
+namespace mdspan{
+
+    /** @brief Converts between linear indices and multi-indices of an extents object
+     *
+     * Linear indices are in last-index-fastest order, i.e. the stride of mode k is extents::size(k + 1).
+     * Divisions by dynamic extents use reciprocals computed once at construction; for extents whose
+     * rank is known at compile time, modes with a static extent divide by a compile-time constant.
+     *
+     * @code auto conv = index_converter( extents<3,4,dynamic_extent,8>{5} );
+     * @code ptrdiff_t idx[3]; conv.to_multi(17, idx);
+     *
+     * @tparam E extents type
+     */
+    template< typename E >
+    struct index_converter{
+        static_assert(is_extent<E>::value,"NOT A EXTENT TYPE");
+
+        using extents_type = E;
+        using index_type = ptrdiff_t;
+        using linear_type = size_t;
+
+        /** @brief Precomputes the divisors of e
+         *
+         * @param e extents whose elements are all > 0
+         */
+        explicit index_converter(E const& e)
+            : _extents(e),
+              _div32( detail::rank_array<E,detail::fast_divisor<31>>::make(e) ),
+              _div64( detail::rank_array<E,detail::fast_divisor<63>>::make(e) ),
+              _narrow( static_cast<size_t>( e.size() ) < ( size_t{1} << 31 ) )
+        {
+            for(auto k = 0u; k < _div64.size(); k++){
+                auto const n = static_cast<size_t>( e.extent(k) );
+                assert( n > 0 );
+                if( _narrow ){
+                    _div32[k] = detail::fast_divisor<31>( static_cast<std::uint32_t>(n) );
+                }
+                _div64[k] = detail::fast_divisor<63>( n );
+            }
+        }
+
+        auto rank() const noexcept{
+            return _div64.size();
+        }
+
+        E const& extents() const noexcept{
+            return _extents;
+        }
+
+        /** @brief Returns the linear index of the multi-index idx[0], ..., idx[rank - 1] */
+        linear_type to_linear(index_type const* idx) const noexcept{
+            auto lin = linear_type{0};
+            for(auto k = 0u; k < rank(); k++){
+                lin = lin * static_cast<linear_type>( _extents.extent(k) ) + static_cast<linear_type>( idx[k] );
+            }
+            return lin;
+        }
+
+        /** @brief Writes the multi-index of the linear index lin into idx[0], ..., idx[rank - 1] */
+        void to_multi(linear_type lin, index_type* idx) const noexcept{
+            if constexpr( detail::is_dynamic_rank_v<E> ){
+                for(auto k = rank(); k-- > 0u;){
+                    auto const q = _div64[k].divide(lin);
+                    idx[k] = static_cast<index_type>( lin - q * _div64[k].divisor() );
+                    lin = q;
+                }
+            }else{
+                to_multi_static( lin, idx, std::make_index_sequence<static_cast<size_t>(E::rank())>{} );
+            }
+        }
+
+        /** @brief Converts a range of linear indices into multi-indices
+         *
+         * The output is stored mode-major (structure-of-arrays): the k-th coordinate of
+         * first[i] is written to out[k * n + i] where n = last - first, so every mode is a
+         * contiguous array and the per-mode division loop vectorizes.
+         *
+         * @param first pointer to the first linear index
+         * @param last pointer past the last linear index
+         * @param out buffer of at least rank() * (last - first) elements
+         */
+        void to_multi(linear_type const* first, linear_type const* last, index_type* out) const{
+            auto const n = static_cast<size_t>( last - first );
+            if( _narrow ){
+                to_multi_batch<std::uint32_t>( _div32, first, n, out );
+            }else{
+                to_multi_batch<std::uint64_t>( _div64, first, n, out );
+            }
+        }
+
+    private:
+
+        template< size_t ... K >
+        void to_multi_static(linear_type lin, index_type* idx, std::index_sequence<K...>) const noexcept{
+            constexpr auto r = sizeof...(K);
+            ( to_multi_mode< r - 1 - K >( lin, idx ), ... );
+        }
+
+        template< size_t K >
+        void to_multi_mode(linear_type& lin, index_type* idx) const noexcept{
+            constexpr auto n = E::static_extent(K);
+            if constexpr( n != dynamic_extent ){
+                idx[K] = static_cast<index_type>( lin % static_cast<linear_type>(n) );
+                lin /= static_cast<linear_type>(n);
+            }else{
+                auto const q = _div64[K].divide(lin);
+                idx[K] = static_cast<index_type>( lin - q * _div64[K].divisor() );
+                lin = q;
+            }
+        }
+
+        template< typename U, typename Divisors >
+        static void to_multi_batch(Divisors const& div, linear_type const* first, size_t n, index_type* out){
+            constexpr size_t block = 256;
+            U buf[block];
+            for(auto i0 = size_t{0}; i0 < n; i0 += block){
+                auto const m = std::min(block, n - i0);
+                for(auto i = size_t{0}; i < m; i++){
+                    buf[i] = static_cast<U>( first[i0 + i] );
+                }
+                for(auto k = div.size(); k-- > 0u;){
+                    auto const d = div[k];
+                    auto* o = out + k * n + i0;
+                    for(auto i = size_t{0}; i < m; i++){
+                        auto const q = d.divide( buf[i] );
+                        o[i] = static_cast<index_type>( buf[i] - q * d.divisor() );
+                        buf[i] = q;
+                    }
+                }
+            }
+        }
+
+        E _extents;
+        detail::rank_array_t<E, detail::fast_divisor<31>> _div32;
+        detail::rank_array_t<E, detail::fast_divisor<63>> _div64;
+        bool _narrow;
+    };
+
+    template< ptrdiff_t D, ptrdiff_t ... E >
+    index_converter(extents<D,E...> const&) -> index_converter< extents<D,E...> >;
+
+    template< ptrdiff_t D, ptrdiff_t ... E >
+    auto make_index_converter(extents<D,E...> const& e){
+        return index_converter< extents<D,E...> >(e);
+    }
+
+}
+
+#endif // INDEX_MAPPING_H
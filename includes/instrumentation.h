@@ -0,0 +1,254 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#ifdef MDSPAN_ENABLE_INSTRUMENTATION
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#endif
+
+/** @brief Hot-path counters and kernel timers
+ *
+ * Compiled in only when MDSPAN_ENABLE_INSTRUMENTATION is defined; otherwise every hook is an
+ * empty inline function and snapshot() returns zeros.
+ *
+ * Counters are kept per thread and only summed by snapshot(), so a hook costs one uncontended
+ * relaxed store on the calling thread's cache line.
+ *
+ * The two variants live in different inline namespaces, so the hooks of a translation unit built
+ * with the macro and of one built without it are distinct entities rather than one with two
+ * definitions. Templates of the library that call the hooks are still instantiated once per
+ * program, so define the macro for the whole program, e.g. on the compiler command line.
+ *
+ * @code instrumentation::snapshot().for_each([](std::string const& name, std::uint64_t v){ export(name, v); });
+ */
+namespace instrumentation{
+
+    enum class counter : std::size_t{
+        extents_allocations,
+        extents_bytes,
+        storage_allocations,
+        storage_bytes,
+        dense_at,
+        dense_set,
+        sparse_at,
+        sparse_get,
+        sparse_set,
+        sparse_compress,
+        numa_fallbacks,
+        count
+    };
+
+    constexpr std::size_t counter_count = static_cast<std::size_t>(counter::count);
+
+    inline char const* counter_name(counter c) noexcept{
+        constexpr char const* names[] = {
+            "extents.allocations",
+            "extents.bytes",
+            "storage.allocations",
+            "storage.bytes",
+            "dense.at",
+            "dense.set",
+            "sparse.at",
+            "sparse.get",
+            "sparse.set",
+            "sparse.compress",
+            "numa.fallbacks"
+        };
+        return names[static_cast<std::size_t>(c)];
+    }
+
+    struct kernel_stats{
+        std::uint64_t calls{0};
+        std::uint64_t nanoseconds{0};
+        std::uint64_t bytes{0};
+    };
+
+    /** @brief Point-in-time copy of all counters and kernel statistics */
+    struct snapshot_type{
+        std::array<std::uint64_t, counter_count> counters{};
+        std::map<std::string, kernel_stats> kernels;
+
+        std::uint64_t operator[](counter c) const noexcept{
+            return counters[static_cast<std::size_t>(c)];
+        }
+
+        /** @brief Calls f(name, value) for every counter and kernel metric as flat key/value pairs */
+        template< typename F >
+        void for_each(F&& f) const{
+            for(auto i = 0u; i < counter_count; i++){
+                f( std::string(counter_name(static_cast<counter>(i))), counters[i] );
+            }
+            for(auto const& [name, s] : kernels){
+                f( "kernel." + name + ".calls", s.calls );
+                f( "kernel." + name + ".nanoseconds", s.nanoseconds );
+                f( "kernel." + name + ".bytes", s.bytes );
+            }
+        }
+    };
+
+#ifdef MDSPAN_ENABLE_INSTRUMENTATION
+
+    constexpr bool enabled = true;
+
+    inline namespace instrumented{
+
+    namespace detail{
+
+        struct thread_counters;
+
+        struct registry{
+            static registry& instance(){
+                static registry r;
+                return r;
+            }
+
+            std::mutex m;
+            std::vector<thread_counters*> live;
+            std::array<std::uint64_t, counter_count> retired{};
+            std::map<std::string, kernel_stats> kernels;
+        };
+
+        struct thread_counters{
+            thread_counters(){
+                auto& r = registry::instance();
+                std::lock_guard<std::mutex> l(r.m);
+                r.live.push_back(this);
+            }
+
+            ~thread_counters(){
+                auto& r = registry::instance();
+                std::lock_guard<std::mutex> l(r.m);
+                for(auto i = 0u; i < counter_count; i++){
+                    r.retired[i] += c[i].load(std::memory_order_relaxed);
+                }
+                r.live.erase( std::find(r.live.begin(), r.live.end(), this) );
+            }
+
+            void add(counter k, std::uint64_t n) noexcept{
+                auto& a = c[static_cast<std::size_t>(k)];
+                a.store( a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed );
+            }
+
+            std::array<std::atomic<std::uint64_t>, counter_count> c{};
+        };
+
+        inline thread_counters& local(){
+            thread_local thread_counters t;
+            return t;
+        }
+
+    }
+
+    inline void count(counter c, std::uint64_t n = 1) noexcept{
+        detail::local().add(c, n);
+    }
+
+    /** @brief Counts one allocation of bytes; c is an *_allocations counter followed by its *_bytes counter */
+    inline void allocation(counter c, std::uint64_t bytes) noexcept{
+        detail::local().add(c, 1);
+        detail::local().add(static_cast<counter>(static_cast<std::size_t>(c) + 1), bytes);
+    }
+
+    inline void record_kernel(std::string const& name, std::uint64_t nanoseconds, std::uint64_t bytes){
+        auto& r = detail::registry::instance();
+        std::lock_guard<std::mutex> l(r.m);
+        auto& s = r.kernels[name];
+        ++s.calls;
+        s.nanoseconds += nanoseconds;
+        s.bytes += bytes;
+    }
+
+    /** @brief Times the enclosing scope and records it under name with the given bytes moved */
+    struct scoped_kernel{
+        explicit scoped_kernel(char const* name, std::uint64_t bytes = 0) noexcept
+            : _name(name), _bytes(bytes), _start(std::chrono::steady_clock::now()){}
+
+        void add_bytes(std::uint64_t bytes) noexcept{ _bytes += bytes; }
+
+        ~scoped_kernel(){
+            auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - _start ).count();
+            record_kernel( _name, static_cast<std::uint64_t>(ns), _bytes );
+        }
+
+        scoped_kernel(scoped_kernel const&) = delete;
+        scoped_kernel& operator=(scoped_kernel const&) = delete;
+
+    private:
+        char const* _name;
+        std::uint64_t _bytes;
+        std::chrono::steady_clock::time_point _start;
+    };
+
+    inline snapshot_type snapshot(){
+        auto& r = detail::registry::instance();
+        std::lock_guard<std::mutex> l(r.m);
+        auto s = snapshot_type{};
+        s.counters = r.retired;
+        for(auto* t : r.live){
+            for(auto i = 0u; i < counter_count; i++){
+                s.counters[i] += t->c[i].load(std::memory_order_relaxed);
+            }
+        }
+        s.kernels = r.kernels;
+        return s;
+    }
+
+    /** @brief Zeroes all counters and kernel statistics
+     *
+     * @note call it while no other thread counts: a hook is a load and a store, not an atomic
+     * increment, so a count running concurrently may write back its old value over the zero
+     */
+    inline void reset(){
+        auto& r = detail::registry::instance();
+        std::lock_guard<std::mutex> l(r.m);
+        r.retired.fill(0);
+        for(auto* t : r.live){
+            for(auto& a : t->c){
+                a.store(0, std::memory_order_relaxed);
+            }
+        }
+        r.kernels.clear();
+    }
+
+    }
+
+#else
+
+    constexpr bool enabled = false;
+
+    inline namespace not_instrumented{
+
+    inline void count(counter, std::uint64_t = 1) noexcept{}
+
+    inline void allocation(counter, std::uint64_t) noexcept{}
+
+    inline void record_kernel(std::string const&, std::uint64_t, std::uint64_t) noexcept{}
+
+    struct scoped_kernel{
+        explicit scoped_kernel(char const*, std::uint64_t = 0) noexcept{}
+        ~scoped_kernel(){}
+        void add_bytes(std::uint64_t) noexcept{}
+    };
+
+    inline snapshot_type snapshot(){
+        return {};
+    }
+
+    inline void reset() noexcept{}
+
+    }
+
+#endif
+
+}
+
+#endif // INSTRUMENTATION_H
@@ -2,8 +2,13 @@
 #define MDSPAN_H
 
 #include "mdspan_helper.h"
+#include "instrumentation.h"
 #include <vector>
 #include <numeric>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <cassert>
 
 namespace mdspan{
     ptrdiff_t const dynamic_dims = -2;
@@ -11,6 +16,44 @@ namespace mdspan{
     template< ptrdiff_t dims, ptrdiff_t ... StaticExtents >
     struct extents ;
 
+    namespace detail{
+
+        // index loops instead of iterators so that the shape predicates of static extents are constant expressions
+
+        template< typename E >
+        constexpr bool all_equal_one(E const& e, size_t first, size_t last) noexcept{
+            for(auto k = first; k < last; k++){
+                if( e.at(k) != 1 ) return false;
+            }
+            return true;
+        }
+
+        template< typename E >
+        constexpr bool any_equal_one(E const& e, size_t first, size_t last) noexcept{
+            for(auto k = first; k < last; k++){
+                if( e.at(k) == 1 ) return true;
+            }
+            return false;
+        }
+
+        template< typename E >
+        constexpr bool all_greater_one(E const& e, size_t first, size_t last) noexcept{
+            for(auto k = first; k < last; k++){
+                if( e.at(k) <= 1 ) return false;
+            }
+            return true;
+        }
+
+        template< typename E >
+        constexpr bool any_greater_one(E const& e, size_t first, size_t last) noexcept{
+            for(auto k = first; k < last; k++){
+                if( e.at(k) > 1 ) return true;
+            }
+            return false;
+        }
+
+    }
+
     template< >
     struct extents<dynamic_dims>{
 
@@ -45,6 +88,7 @@ namespace mdspan{
         explicit extents(base_type const& b)
         : _base(b)
         {
+            instrumentation::allocation(instrumentation::counter::extents_allocations, _base.size() * sizeof(value_type));
             if (!this->valid()){
                 throw std::length_error("Error in extents::extents() : shape tuple is not a valid permutation: has zero elements.");
             }
@@ -77,6 +121,7 @@ namespace mdspan{
         extents(std::initializer_list<value_type> l)
         : extents( base_type(std::move(l)) )
         {
+            instrumentation::allocation(instrumentation::counter::extents_allocations, _base.size() * sizeof(value_type));
         }
 
         /** @brief Constructs extents from a range specified by two iterators
@@ -91,12 +136,14 @@ namespace mdspan{
         extents(const_iterator first, const_iterator last)
         : extents ( base_type( first,last ) )
         {
+            instrumentation::allocation(instrumentation::counter::extents_allocations, _base.size() * sizeof(value_type));
         }
 
         /** @brief Copy constructs extents */
         extents(extents const& l )
         : _base(l._base)
         {
+            instrumentation::allocation(instrumentation::counter::extents_allocations, _base.size() * sizeof(value_type));
         }
 
         /** @brief Move constructs extents */
@@ -118,25 +165,25 @@ namespace mdspan{
         }
 
 
-        constexpr auto rank() noexcept {
+        auto rank() const noexcept {
             return _base.size();
         }
-        constexpr auto rank_dyanmic() noexcept {
+        auto rank_dyanmic() const noexcept {
             return _base.size();
         }
-        constexpr auto static_extent(int) noexcept {
-            return 0;
+        static constexpr auto static_extent(int) noexcept {
+            return dynamic_extent;
         }
 
-        constexpr auto extent(int k) const noexcept {
-            return _base.at(k);
+        auto extent(int k) const noexcept {
+            return _base[k];
         }
 
         auto size(int k) const noexcept {
             return std::accumulate(_base.cbegin() + k, _base.cend(),1ul,std::multiplies<>());
         }
 
-        constexpr auto size() const noexcept {
+        auto size() const noexcept {
             return product();
         }
 
@@ -245,11 +292,11 @@ namespace mdspan{
         //     return this->_base.size();
         // }
 
-        /** @brief Returns true if size > 1 and all elements > 0 */
+        /** @brief Returns true if rank > 0 and all elements > 0 */
         bool valid() const
         {
             return
-                this->size() > 1 &&
+                !this->_base.empty() &&
                 std::none_of(_base.begin(), _base.end(),
                             [](const_reference a){ return a == value_type(0); });
         }
@@ -389,7 +436,7 @@ namespace mdspan{
         constexpr bool is_scalar() const noexcept{
             return
                 rank() != 0 &&
-                all_of(*this, [](auto const& a){ return a == 1;});
+                detail::all_equal_one(*this, 0, rank());
         }
 
         constexpr auto begin() const noexcept{
@@ -409,13 +456,10 @@ namespace mdspan{
                 return at(0) > 1;
             }
 
-            auto greater_one = [](auto const& a){ return a >  1;};
-            auto equal_one   = [](auto const& a){ return a == 1;};
-
             return
-                std::any_of(begin(), begin() + 2, greater_one) &&
-                std::any_of(begin(), begin() + 2, equal_one  ) &&
-                std::all_of(begin() + 2, end(), equal_one);
+                detail::any_greater_one(*this, 0, 2) &&
+                detail::any_equal_one(*this, 0, 2) &&
+                detail::all_equal_one(*this, 2, rank());
         }
 
         constexpr bool is_matrix() const noexcept{
@@ -423,12 +467,9 @@ namespace mdspan{
                 return false;
             }
 
-            auto greater_one = [](auto const& a){ return a >  1;};
-            auto equal_one   = [](auto const& a){ return a == 1;};
-
             return
-                std::all_of ( begin(), begin() + 2, greater_one) &&
-                std::all_of ( begin() + 2, end(),     equal_one  );
+                detail::all_greater_one(*this, 0, 2) &&
+                detail::all_equal_one(*this, 2, rank());
         }
 
         constexpr bool is_tensor() const noexcept{
@@ -436,9 +477,7 @@ namespace mdspan{
                 return false;
             }
 
-            auto greater_one = [](auto const& a){ return a > 1;};
-
-            return std::any_of(begin() + 2, end(), greater_one);
+            return detail::any_greater_one(*this, 2, rank());
         }
 
         auto to_vector() const noexcept{
@@ -498,6 +537,12 @@ namespace mdspan{
         template< typename Parent >
         struct Iterator{
 
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = ptrdiff_t;
+            using difference_type = ptrdiff_t;
+            using pointer = value_type const*;
+            using reference = value_type;
+
             Iterator(Parent const& p,size_type pos):_p(p),_pos(pos){}
 
             bool operator==( Iterator const& rhs){
@@ -542,6 +587,51 @@ namespace mdspan{
         };
     };
 
+    /** @brief Returns the extents without the mode at pos
+     *
+     * @code remove_extent_item( extents<dynamic_dims>{2,3,4}, 1 ) -> {2,4}
+     *
+     * @note removing the only mode yields empty extents
+     */
+    inline extents<dynamic_dims> remove_extent_item(extents<dynamic_dims> const& e, size_t pos){
+        assert(pos < e.rank());
+        auto arr = e.base();
+        arr.erase(arr.begin() + static_cast<ptrdiff_t>(pos));
+        return arr.empty() ? extents<dynamic_dims>{} : extents<dynamic_dims>( std::move(arr) );
+    }
+
+    /** @brief Returns the modes of lhs followed by the modes of rhs
+     *
+     * @code concat_extent( extents<dynamic_dims>{2,3}, extents<dynamic_dims>{4} ) -> {2,3,4}
+     */
+    inline extents<dynamic_dims> concat_extent(extents<dynamic_dims> const& lhs, extents<dynamic_dims> const& rhs){
+        auto arr = lhs.base();
+        arr.insert(arr.end(), rhs.begin(), rhs.end());
+        return arr.empty() ? extents<dynamic_dims>{} : extents<dynamic_dims>( std::move(arr) );
+    }
+
+    /** @brief Converts any extents to extents<dynamic_dims> */
+    inline extents<dynamic_dims> to_dynamic(extents<dynamic_dims> const& e){
+        return e;
+    }
+
+    template< ptrdiff_t D, ptrdiff_t ... E >
+    extents<dynamic_dims> to_dynamic(extents<D,E...> const& e){
+        return extents<dynamic_dims>( e.to_vector() );
+    }
+
+    /** @brief Returns the strides of a last-index-fastest layout: stride(k) = extents::size(k + 1) */
+    template< ptrdiff_t D, ptrdiff_t ... E >
+    std::vector<ptrdiff_t> row_major_strides(extents<D,E...> const& e){
+        auto s = std::vector<ptrdiff_t>( e.rank() );
+        auto acc = ptrdiff_t{1};
+        for(auto k = s.size(); k-- > 0u;){
+            s[k] = acc;
+            acc *= static_cast<ptrdiff_t>( e.extent(k) );
+        }
+        return s;
+    }
+
     template < ptrdiff_t D, ptrdiff_t ...E >
     using extents_t = std::conditional_t<
         D == dynamic_dims,
@@ -549,7 +639,7 @@ namespace mdspan{
         std::conditional_t<
             ( D > 500 || D <= 0),
             extents<dynamic_dims>,
-            extents<D>
+            extents<D,E...>
         >
     >;
 
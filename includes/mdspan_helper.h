@@ -4,6 +4,7 @@
 #include "seq.h"
 #include <initializer_list>
 #include <array>
+#include <cassert>
 
 namespace mdspan::detail{
 
@@ -196,7 +197,8 @@ namespace mdspan{
 
     template < ptrdiff_t dims, ptrdiff_t... lhs>
     auto remove_extent_item(extents< dims, lhs... > const& lhs_extent, size_t pos){
-        static_assert(dims > ptrdiff_t{0} && pos < dims);
+        static_assert(dims > ptrdiff_t{0});
+        assert(pos < size_t(dims));
         
         using type = extents< dims - 1 >;
         std::array<ptrdiff_t,dims - 1> arr;
@@ -0,0 +1,328 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include "parallel.h"
+#include "storage_policy.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace numa::detail{
+
+    /** @brief Parses a sysfs list such as "0-3,8,10-11" */
+    inline std::vector<int> parse_list(std::string const& s){
+        auto r = std::vector<int>{};
+        auto p = s.c_str();
+        while( *p ){
+            char* end = nullptr;
+            auto const a = static_cast<int>( std::strtol(p, &end, 10) );
+            if( end == p ) break;
+            auto b = a;
+            p = end;
+            if( *p == '-' ){
+                b = static_cast<int>( std::strtol(p + 1, &end, 10) );
+                p = end;
+            }
+            for(auto x = a; x <= b; x++){
+                r.push_back(x);
+            }
+            if( *p == ',' ) p++;
+            else break;
+        }
+        return r;
+    }
+
+    inline std::string read_line(std::string const& path){
+        auto line = std::string{};
+        if( auto* f = std::fopen(path.c_str(), "r") ){
+            char buf[4096];
+            if( std::fgets(buf, sizeof(buf), f) ){
+                line = buf;
+            }
+            std::fclose(f);
+        }
+        return line;
+    }
+
+#if defined(__linux__)
+    // from <linux/mempolicy.h>, which is not always installed
+    constexpr int mpol_bind = 2;
+    constexpr int mpol_interleave = 3;
+
+    inline bool mbind(void* p, size_t bytes, int mode, std::vector<int> const& nodes){
+        auto mask = std::vector<unsigned long>(16, 0ul);
+        auto constexpr bits = 8u * sizeof(unsigned long);
+        for(auto n : nodes){
+            if( n >= 0 && size_t(n) < mask.size() * bits ){
+                mask[size_t(n) / bits] |= 1ul << ( size_t(n) % bits );
+            }
+        }
+        return ::syscall(SYS_mbind, p, bytes, mode, mask.data(), mask.size() * bits + 1u, 0u) == 0;
+    }
+#endif
+
+}
+
+namespace numa{
+
+    /** @brief NUMA nodes and their CPUs, restricted to the CPUs this process may run on */
+    struct topology_type{
+        std::vector<int> nodes;
+        std::vector<int> cpus;       // usable CPUs ordered by node, so neighbouring parts share a node
+        std::vector<int> cpu_node;   // node of cpus[i]
+    };
+
+    /** @brief Topology read once from /sys/devices/system/node; a single node holding every usable CPU if unavailable */
+    inline topology_type const& topology(){
+        static auto const t = []{
+            auto r = topology_type{};
+#if defined(__linux__)
+            auto allowed = cpu_set_t{};
+            CPU_ZERO(&allowed);
+            auto const have_mask = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+            auto usable = [&](int c){ return !have_mask || ( c < CPU_SETSIZE && CPU_ISSET(c, &allowed) ); };
+
+            r.nodes = detail::parse_list( detail::read_line("/sys/devices/system/node/online") );
+            for(auto n : r.nodes){
+                for(auto c : detail::parse_list( detail::read_line("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist") )){
+                    if( usable(c) ){
+                        r.cpus.push_back(c);
+                        r.cpu_node.push_back(n);
+                    }
+                }
+            }
+            if( r.cpus.empty() ){
+                r.nodes = {0};
+                for(auto c = 0; c < CPU_SETSIZE; c++){
+                    if( have_mask && CPU_ISSET(c, &allowed) ){
+                        r.cpus.push_back(c);
+                        r.cpu_node.push_back(0);
+                    }
+                }
+            }
+#endif
+            if( r.nodes.empty() ){
+                r.nodes = {0};
+            }
+            return r;
+        }();
+        return t;
+    }
+
+    inline size_t node_count(){
+        return topology().nodes.size();
+    }
+
+    /** @brief CPU that part t of `parts` runs on, spreading parts evenly over the node-ordered CPUs, or -1 */
+    inline int cpu_of_part(size_t t, size_t parts){
+        auto const& cpus = topology().cpus;
+        return cpus.empty() ? -1 : cpus[ t * cpus.size() / std::max<size_t>(parts, 1) ];
+    }
+
+    /** @brief Pins the calling thread to one CPU and restores its previous affinity on destruction */
+    struct scoped_pin{
+        explicit scoped_pin(int cpu){
+#if defined(__linux__)
+            if( cpu < 0 || ::sched_getaffinity(0, sizeof(_old), &_old) != 0 ){
+                return;
+            }
+            auto set = cpu_set_t{};
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            _pinned = ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+            (void)cpu;
+#endif
+        }
+
+        ~scoped_pin(){
+#if defined(__linux__)
+            if( _pinned ){
+                ::sched_setaffinity(0, sizeof(_old), &_old);
+            }
+#endif
+        }
+
+        scoped_pin(scoped_pin const&) = delete;
+        scoped_pin& operator=(scoped_pin const&) = delete;
+
+    private:
+#if defined(__linux__)
+        cpu_set_t _old{};
+#endif
+        bool _pinned{false};
+    };
+
+    /** @brief parallel::parallel_for with part t pinned to cpu_of_part(t, threads)
+     *
+     * The partition is a function of n and threads only, so data first touched by this loop and
+     * processed later by this loop with the same n and threads is processed on the node it lives on.
+     */
+    template< typename F >
+    void parallel_for(size_t n, F&& f, size_t threads = parallel::concurrency()){
+        threads = std::max<size_t>( 1, std::min(threads, n) );
+        parallel::parallel_for(n, [&](size_t b, size_t e, size_t t){
+            auto const pin = scoped_pin( cpu_of_part(t, threads) );
+            f(b, e, t);
+        }, threads);
+    }
+
+    /** @brief Restricts the pages of [p, p + bytes) to one node; p must be page aligned */
+    inline bool bind(void* p, size_t bytes, int node){
+#if defined(__linux__)
+        return detail::mbind(p, bytes, detail::mpol_bind, {node});
+#else
+        (void)p; (void)bytes; (void)node;
+        return false;
+#endif
+    }
+
+    /** @brief Spreads the pages of [p, p + bytes) round-robin over all nodes; p must be page aligned */
+    inline bool interleave(void* p, size_t bytes){
+#if defined(__linux__)
+        return detail::mbind(p, bytes, detail::mpol_interleave, topology().nodes);
+#else
+        (void)p; (void)bytes;
+        return false;
+#endif
+    }
+
+    /** @brief Page placement of numa::allocator */
+    enum class policy{
+        first_touch,    // a page lives on the node of the thread that writes it first
+        interleave      // pages alternate over all nodes
+    };
+
+    /** @brief Page-granular allocator with NUMA placement that default-initializes elements
+     *
+     * Memory comes straight from mmap, so no page is touched by allocation. Elements are not
+     * value-initialized by construct(); the storage_traits of numa vectors initialize them with
+     * numa::parallel_for instead, which places first_touch pages on the nodes of the threads
+     * that later run numa::parallel_for over the same range.
+     *
+     * @note If the kernel refuses the interleave policy, e.g. inside a container without the
+     * permission, the pages are left to first touch and counter::numa_fallbacks is incremented.
+     */
+    template< typename T, policy P >
+    struct allocator{
+        using value_type = T;
+
+        template< typename U >
+        struct rebind{
+            using other = allocator<U, P>;
+        };
+
+        allocator() noexcept = default;
+
+        template< typename U >
+        allocator(allocator<U, P> const&) noexcept{}
+
+        T* allocate(size_t n){
+            if( n > std::numeric_limits<size_t>::max() / sizeof(T) ){
+                throw std::bad_array_new_length();
+            }
+#if defined(__linux__)
+            auto const bytes = std::max<size_t>( n * sizeof(T), 1u );
+            auto* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if( p == MAP_FAILED ){
+                throw std::bad_alloc();
+            }
+            if constexpr( P == policy::interleave ){
+                if( !interleave(p, bytes) ){
+                    instrumentation::count(instrumentation::counter::numa_fallbacks);
+                }
+            }
+            return static_cast<T*>(p);
+#else
+            return std::allocator<T>{}.allocate(n);
+#endif
+        }
+
+        void deallocate(T* p, size_t n) noexcept{
+#if defined(__linux__)
+            ::munmap(p, std::max<size_t>( n * sizeof(T), 1u ));
+#else
+            std::allocator<T>{}.deallocate(p, n);
+#endif
+        }
+
+        template< typename U >
+        void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>){
+            ::new(static_cast<void*>(p)) U;
+        }
+
+        template< typename U, typename ... Args >
+        void construct(U* p, Args&& ... args){
+            ::new(static_cast<void*>(p)) U( std::forward<Args>(args)... );
+        }
+
+        template< typename U >
+        bool operator==(allocator<U, P> const&) const noexcept{ return true; }
+        template< typename U >
+        bool operator!=(allocator<U, P> const&) const noexcept{ return false; }
+    };
+
+    template< typename T >
+    using first_touch_vector = std::vector< T, allocator<T, policy::first_touch> >;
+
+    template< typename T >
+    using interleaved_vector = std::vector< T, allocator<T, policy::interleave> >;
+
+}
+
+namespace storage_type{
+
+    /** @brief NUMA vectors are initialized in parallel by numa::parallel_for
+     *
+     * @note generate() calls the generator concurrently from several threads
+     */
+    template< typename T, numa::policy P >
+    struct storage_traits< std::vector< T, numa::allocator<T, P> > >{
+        using S = std::vector< T, numa::allocator<T, P> >;
+        using value_type = T;
+
+        static constexpr bool default_initializes = true;
+
+        static S make(size_t n, uninitialized_t){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(value_type));
+            return S(n);
+        }
+
+        static S make(size_t n, value_initialized_t){
+            return make(n, value_type{});
+        }
+
+        static S make(size_t n, value_type const& v){
+            auto s = make(n, uninitialized);
+            numa::parallel_for(n, [&](size_t b, size_t e, size_t){
+                std::fill(s.data() + b, s.data() + e, v);
+            });
+            return s;
+        }
+
+        template< typename F >
+        static S generate(size_t n, F&& gen){
+            auto s = make(n, uninitialized);
+            numa::parallel_for(n, [&](size_t b, size_t e, size_t){
+                for(auto k = b; k < e; k++){
+                    s[k] = gen(k);
+                }
+            });
+            return s;
+        }
+    };
+
+}
+
+#endif // NUMA_H
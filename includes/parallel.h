@@ -0,0 +1,77 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel{
+
+    /** @brief Number of hardware threads, at least 1 */
+    inline size_t concurrency() noexcept{
+        return std::max<size_t>( 1, std::thread::hardware_concurrency() );
+    }
+
+    /** @brief Half-open range [begin, end) of part t when n items are split into p near-equal parts */
+    inline std::pair<size_t,size_t> partition(size_t n, size_t p, size_t t) noexcept{
+        auto const q = n / p;
+        auto const r = n % p;
+        auto const begin = t * q + std::min(t, r);
+        return { begin, begin + q + ( t < r ? 1u : 0u ) };
+    }
+
+    /** @brief Runs f(begin, end, t) on `threads` static, contiguous parts of [0, n)
+     *
+     * Part t is run by thread t; the calling thread runs part 0. Parts are fixed up front, so
+     * per-part state indexed by t (histograms, counts) needs no synchronization and the
+     * first-touch placement of pages written by part t follows thread t.
+     * The first exception thrown by any part is rethrown after every part has finished.
+     *
+     * @code parallel_for( v.size(), [&](size_t b, size_t e, size_t){ std::fill(v.data() + b, v.data() + e, 0); } );
+     *
+     * @param n number of items
+     * @param f callable taking (begin, end, part)
+     * @param threads number of parts, clamped to [1, n]
+     */
+    template< typename F >
+    void parallel_for(size_t n, F&& f, size_t threads = concurrency()){
+        threads = std::max<size_t>( 1, std::min(threads, n) );
+        if( threads == 1u ){
+            f(size_t{0}, n, size_t{0});
+            return;
+        }
+
+        auto error = std::exception_ptr{};
+        auto m = std::mutex{};
+        auto run = [&](size_t t){
+            auto const [b, e] = partition(n, threads, t);
+            try{
+                f(b, e, t);
+            }catch(...){
+                std::lock_guard<std::mutex> l(m);
+                if( !error ){
+                    error = std::current_exception();
+                }
+            }
+        };
+
+        auto pool = std::vector<std::thread>{};
+        pool.reserve(threads - 1u);
+        for(auto t = size_t{1}; t < threads; t++){
+            pool.emplace_back(run, t);
+        }
+        run(0);
+        for(auto& th : pool){
+            th.join();
+        }
+        if( error ){
+            std::rethrow_exception(error);
+        }
+    }
+
+}
+
+#endif // PARALLEL_H
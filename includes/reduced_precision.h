@@ -0,0 +1,360 @@
+#ifndef REDUCED_PRECISION_H
+#define REDUCED_PRECISION_H
+
+#include "storage_policy.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+namespace storage_type::precision{
+
+    inline std::uint32_t bits(float f) noexcept{
+        std::uint32_t u;
+        std::memcpy(&u, &f, sizeof(u));
+        return u;
+    }
+
+    inline float from_bits(std::uint32_t u) noexcept{
+        float f;
+        std::memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+
+    /** @brief IEEE binary16, stored as its bit pattern */
+    struct fp16{
+        using encoded_type = std::uint16_t;
+
+        /** @brief Rounds to nearest even; overflow gives infinity, NaN stays NaN */
+        static encoded_type encode(float f) noexcept{
+            auto x = bits(f);
+            auto const sign = static_cast<encoded_type>( ( x >> 16 ) & 0x8000u );
+            x &= 0x7fffffffu;
+            if( x >= 0x47800000u ){
+                return sign | ( x > 0x7f800000u ? 0x7e00u : 0x7c00u );
+            }
+            if( x < 0x38800000u ){
+                // subnormal: adding 0.5f aligns the half ulp with the float ulp, the FPU rounds
+                return sign | static_cast<encoded_type>( bits( from_bits(x) + 0.5f ) - 0x3f000000u );
+            }
+            auto const odd = ( x >> 13 ) & 1u;
+            x += ( static_cast<std::uint32_t>(15 - 127) << 23 ) + 0xfffu + odd;
+            return sign | static_cast<encoded_type>( x >> 13 );
+        }
+
+        static float decode(encoded_type h) noexcept{
+            constexpr auto shifted_exp = std::uint32_t{0x7c00u} << 13;
+            auto u = ( std::uint32_t{h} & 0x7fffu ) << 13;
+            auto const exp = shifted_exp & u;
+            u += static_cast<std::uint32_t>(127 - 15) << 23;
+            if( exp == shifted_exp ){
+                u += static_cast<std::uint32_t>(128 - 16) << 23;
+            }else if( exp == 0 ){
+                u += 1u << 23;
+                u = bits( from_bits(u) - from_bits(113u << 23) );
+            }
+            return from_bits( u | ( ( std::uint32_t{h} & 0x8000u ) << 16 ) );
+        }
+
+        static void encode(float const* in, encoded_type* out, size_t n) noexcept{
+            auto i = size_t{0};
+#if defined(__F16C__) && defined(__AVX__)
+            for(; i + 8 <= n; i += 8){
+                auto const v = _mm256_loadu_ps(in + i);
+                _mm_storeu_si128( reinterpret_cast<__m128i*>(out + i), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT) );
+            }
+#endif
+            for(; i < n; i++){
+                out[i] = encode(in[i]);
+            }
+        }
+
+        static void decode(encoded_type const* in, float* out, size_t n) noexcept{
+            auto i = size_t{0};
+#if defined(__F16C__) && defined(__AVX__)
+            for(; i + 8 <= n; i += 8){
+                auto const v = _mm_loadu_si128( reinterpret_cast<__m128i const*>(in + i) );
+                _mm256_storeu_ps( out + i, _mm256_cvtph_ps(v) );
+            }
+#endif
+            for(; i < n; i++){
+                out[i] = decode(in[i]);
+            }
+        }
+    };
+
+    /** @brief bfloat16 (upper half of binary32), stored as its bit pattern */
+    struct bf16{
+        using encoded_type = std::uint16_t;
+
+        /** @brief Rounds to nearest even; NaN stays NaN */
+        static encoded_type encode(float f) noexcept{
+            auto const x = bits(f);
+            if( ( x & 0x7fffffffu ) > 0x7f800000u ){
+                return static_cast<encoded_type>( ( x >> 16 ) | 0x40u );
+            }
+            return static_cast<encoded_type>( ( x + 0x7fffu + ( ( x >> 16 ) & 1u ) ) >> 16 );
+        }
+
+        static float decode(encoded_type h) noexcept{
+            return from_bits( std::uint32_t{h} << 16 );
+        }
+
+        // branch-free bodies, the compiler vectorizes both loops
+
+        static void encode(float const* in, encoded_type* out, size_t n) noexcept{
+            for(auto i = size_t{0}; i < n; i++){
+                auto const x = bits(in[i]);
+                auto const r = ( x + 0x7fffu + ( ( x >> 16 ) & 1u ) ) >> 16;
+                auto const q = ( x >> 16 ) | 0x40u;
+                out[i] = static_cast<encoded_type>( ( x & 0x7fffffffu ) > 0x7f800000u ? q : r );
+            }
+        }
+
+        static void decode(encoded_type const* in, float* out, size_t n) noexcept{
+            for(auto i = size_t{0}; i < n; i++){
+                out[i] = from_bits( std::uint32_t{in[i]} << 16 );
+            }
+        }
+    };
+
+}
+
+namespace storage_type::dense_tensor{
+
+    /** @brief Dense storage keeping elements as fp16 or bf16 while the logical type stays T
+     *
+     * Element access converts on the fly; load() and store() convert whole ranges with the
+     * vectorized kernels of the format, which is how kernels should move data in and out.
+     *
+     * @code auto s = reduced_dense<float, precision::bf16>( 1024 );
+     *
+     * @note does not derive from storage_interface: no T& can refer into the encoded buffer
+     *
+     * @tparam T logical value type
+     * @tparam Format precision::fp16 or precision::bf16
+     */
+    template < typename T, typename Format >
+    struct reduced_dense{
+        using value_type = T;
+        using format_type = Format;
+        using encoded_type = typename Format::encoded_type;
+
+        reduced_dense() = default;
+
+        explicit reduced_dense(size_t n)
+            : _m( n, Format::encode( T{} ) ){}
+
+        reduced_dense(size_t n, uninitialized_t)
+            : _m(n){}
+
+        T at(size_t k) const{
+            instrumentation::count(instrumentation::counter::dense_at);
+            return static_cast<T>( Format::decode(_m[k]) );
+        }
+
+        void set(T v, size_t k){
+            instrumentation::count(instrumentation::counter::dense_set);
+            _m[k] = Format::encode( static_cast<float>(v) );
+        }
+
+        T get(T, size_t k) const{
+            return at(k);
+        }
+
+        /** @brief Decodes the elements [first, first + n) into out */
+        void load(size_t first, size_t n, float* out) const noexcept{
+            Format::decode(_m.data() + first, out, n);
+        }
+
+        /** @brief Encodes in[0, n) into the elements [first, first + n) */
+        void store(size_t first, size_t n, float const* in) noexcept{
+            Format::encode(in, _m.data() + first, n);
+        }
+
+        encoded_type const* data() const noexcept{ return _m.data(); }
+        encoded_type* data() noexcept{ return _m.data(); }
+        size_t size() const noexcept{ return _m.size(); }
+        size_t bytes() const noexcept{ return _m.size() * sizeof(encoded_type); }
+
+    private:
+        uninitialized_vector<encoded_type> _m;
+    };
+
+    /** @brief Dense storage of int8 values with one float scale per block of Block elements
+     *
+     * An element is q * scale of its block, with scale = max|x| / 127 over the block when it was
+     * stored. Bulk store() quantizes whole blocks; set() re-quantizes the block it touches.
+     *
+     * @code auto s = block_int8_dense<float, 64>( 1 << 20 );
+     *
+     * @tparam T logical value type
+     * @tparam Block number of elements sharing a scale
+     */
+    template < typename T, size_t Block = 32 >
+    struct block_int8_dense{
+        static_assert(Block > 0);
+
+        using value_type = T;
+        using encoded_type = std::int8_t;
+
+        static constexpr size_t block_size = Block;
+
+        block_int8_dense() = default;
+
+        explicit block_int8_dense(size_t n)
+            : _q(n, 0), _scale( ( n + Block - 1 ) / Block, 0.f ){}
+
+        block_int8_dense(size_t n, uninitialized_t)
+            : _q(n), _scale( ( n + Block - 1 ) / Block ){}
+
+        T at(size_t k) const{
+            instrumentation::count(instrumentation::counter::dense_at);
+            return static_cast<T>( _q[k] * _scale[k / Block] );
+        }
+
+        void set(T v, size_t k){
+            instrumentation::count(instrumentation::counter::dense_set);
+            auto const first = k - k % Block;
+            auto const n = std::min(Block, size() - first);
+            float tmp[Block];
+            load(first, n, tmp);
+            tmp[k - first] = static_cast<float>(v);
+            store(first, n, tmp);
+        }
+
+        T get(T, size_t k) const{
+            return at(k);
+        }
+
+        /** @brief Dequantizes the elements [first, first + n) into out */
+        void load(size_t first, size_t n, float* out) const noexcept{
+            auto const last = first + n;
+            while( first < last ){
+                auto const b = first / Block;
+                auto const end = std::min( last, ( b + 1 ) * Block );
+                auto const s = _scale[b];
+                auto const* q = _q.data() + first;
+                for(auto i = size_t{0}; i < end - first; i++){
+                    out[i] = q[i] * s;
+                }
+                out += end - first;
+                first = end;
+            }
+        }
+
+        /** @brief Quantizes in[0, n) into the elements [first, first + n)
+         *
+         * @note first must be a multiple of Block, and n too unless the range ends at size()
+         */
+        void store(size_t first, size_t n, float const* in) noexcept{
+            assert( first % Block == 0 && ( n % Block == 0 || first + n == size() ) );
+            for(auto i = size_t{0}; i < n; i += Block){
+                auto const m = std::min(Block, n - i);
+                auto amax = 0.f;
+                for(auto j = size_t{0}; j < m; j++){
+                    amax = std::max( amax, std::fabs(in[i + j]) );
+                }
+                auto const s = amax / 127.f;
+                auto const inv = amax > 0.f ? 127.f / amax : 0.f;
+                auto* q = _q.data() + first + i;
+                for(auto j = size_t{0}; j < m; j++){
+                    q[j] = static_cast<encoded_type>( std::lrint( in[i + j] * inv ) );
+                }
+                _scale[ ( first + i ) / Block ] = s;
+            }
+        }
+
+        encoded_type const* data() const noexcept{ return _q.data(); }
+        float const* scales() const noexcept{ return _scale.data(); }
+        size_t size() const noexcept{ return _q.size(); }
+        size_t bytes() const noexcept{ return _q.size() * sizeof(encoded_type) + _scale.size() * sizeof(float); }
+
+    private:
+        uninitialized_vector<encoded_type> _q;
+        uninitialized_vector<float> _scale;
+    };
+
+}
+
+namespace storage_type{
+
+    template< typename T, typename Format >
+    struct storage_traits< dense_tensor::reduced_dense<T,Format> >{
+        using value_type = T;
+        using storage = dense_tensor::reduced_dense<T,Format>;
+
+        static storage make(size_t n, uninitialized_t tag){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(typename Format::encoded_type));
+            return storage(n, tag);
+        }
+
+        static storage make(size_t n, value_initialized_t){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(typename Format::encoded_type));
+            return storage(n);
+        }
+
+        static storage make(size_t n, value_type const& v){
+            return generate(n, [&v](size_t){ return v; });
+        }
+
+        /** @brief Encodes gen(k) through a float buffer so store() runs the vectorized conversion */
+        template< typename G >
+        static storage generate(size_t n, G&& gen){
+            auto s = make(n, uninitialized);
+            constexpr auto chunk = size_t{4096};
+            auto buf = dense_tensor::uninitialized_vector<float>( std::min(chunk, n) );
+            for(auto first = size_t{0}; first < n; first += chunk){
+                auto const m = std::min(chunk, n - first);
+                for(auto i = size_t{0}; i < m; i++){
+                    buf[i] = static_cast<float>( gen(first + i) );
+                }
+                s.store(first, m, buf.data());
+            }
+            return s;
+        }
+    };
+
+    template< typename T, size_t Block >
+    struct storage_traits< dense_tensor::block_int8_dense<T,Block> >{
+        using value_type = T;
+        using storage = dense_tensor::block_int8_dense<T,Block>;
+
+        static storage make(size_t n, uninitialized_t tag){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n + ( n + Block - 1 ) / Block * sizeof(float));
+            return storage(n, tag);
+        }
+
+        static storage make(size_t n, value_initialized_t){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n + ( n + Block - 1 ) / Block * sizeof(float));
+            return storage(n);
+        }
+
+        static storage make(size_t n, value_type const& v){
+            return generate(n, [&v](size_t){ return v; });
+        }
+
+        /** @brief Quantizes gen(k) block-wise; the chunk is a multiple of Block so every store() covers whole blocks */
+        template< typename G >
+        static storage generate(size_t n, G&& gen){
+            auto s = make(n, uninitialized);
+            constexpr auto chunk = ( 4096 / Block + 1 ) * Block;
+            static_assert( chunk % Block == 0 );
+            auto buf = dense_tensor::uninitialized_vector<float>( std::min(chunk, n) );
+            for(auto first = size_t{0}; first < n; first += chunk){
+                auto const m = std::min(chunk, n - first);
+                for(auto i = size_t{0}; i < m; i++){
+                    buf[i] = static_cast<float>( gen(first + i) );
+                }
+                s.store(first, m, buf.data());
+            }
+            return s;
+        }
+    };
+
+}
+
+#endif // REDUCED_PRECISION_H
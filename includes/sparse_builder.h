@@ -0,0 +1,329 @@
+#ifndef SPARSE_BUILDER_H
+#define SPARSE_BUILDER_H
+
+#include "storage_policy.h"
+#include "index_mapping.h"
+#include "parallel.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+namespace storage_type::sparse_tensor{
+
+    using index_array = dense_tensor::uninitialized_vector<size_t>;
+
+    /** @brief Strictly increasing linear indices and their values */
+    template< typename T >
+    struct sorted_entries{
+        index_array index;
+        dense_tensor::uninitialized_vector<T> values;
+    };
+
+    /** @brief Compressed sparse rows of a rows x cols matrix
+     *
+     * The entries of row r are col_index[k], values[k] for row_ptr[r] <= k < row_ptr[r + 1].
+     */
+    template< typename T >
+    struct csr{
+        size_t rows{0};
+        size_t cols{0};
+        index_array row_ptr;
+        index_array col_index;
+        dense_tensor::uninitialized_vector<T> values;
+    };
+
+    /** @brief Compressed sparse fibers of a tensor of any rank, modes in order
+     *
+     * Level l holds the distinct non-empty index prefixes (i_0, ..., i_l): fids[l][f] is i_l of
+     * fiber f, and its children in level l + 1 are fptr[l][f] <= c < fptr[l][f + 1]. The last
+     * level is parallel to values; a rank 2 csf is csr without empty rows.
+     */
+    template< typename T >
+    struct csf{
+        std::vector<ptrdiff_t> extents;
+        std::vector<index_array> fptr;
+        std::vector<index_array> fids;
+        dense_tensor::uninitialized_vector<T> values;
+    };
+
+}
+
+namespace storage_type::sparse_tensor::detail{
+
+    constexpr size_t radix_bits = 11;
+    constexpr size_t radix_buckets = size_t{1} << radix_bits;
+
+    /** @brief Stable parallel LSD radix sort of keys < universe, permuting values along
+     *
+     * Every pass histograms the static part of each thread, turns the histograms into per-thread,
+     * per-digit output offsets and scatters; equal keys keep their input order. Passes in which
+     * every key has the same digit are skipped.
+     */
+    template< typename T >
+    void radix_sort(size_t const* keys, T const* values, size_t n, size_t universe, size_t threads,
+                    index_array& out_keys, dense_tensor::uninitialized_vector<T>& out_values)
+    {
+        threads = std::max<size_t>( 1, std::min(threads, n) );
+        auto bits = size_t{0};
+        while( universe > 1u && bits < 64u && ( universe - 1u ) >> bits ){
+            bits++;
+        }
+
+        auto ka = index_array(n), kb = index_array(n);
+        auto va = dense_tensor::uninitialized_vector<T>(n), vb = dense_tensor::uninitialized_vector<T>(n);
+        auto hist = std::vector<size_t>(threads * radix_buckets);
+        auto const* src_k = keys;
+        auto const* src_v = values;
+        auto* dst_k = ka.data();
+        auto* dst_v = va.data();
+        auto sorted = false;
+
+        for(auto shift = size_t{0}; shift < bits; shift += radix_bits){
+            std::fill(hist.begin(), hist.end(), size_t{0});
+            parallel::parallel_for(n, [&](size_t b, size_t e, size_t t){
+                auto* h = hist.data() + t * radix_buckets;
+                for(auto i = b; i < e; i++){
+                    h[ ( src_k[i] >> shift ) & ( radix_buckets - 1u ) ]++;
+                }
+            }, threads);
+
+            auto off = size_t{0};
+            auto skip = false;
+            for(auto d = size_t{0}; d < radix_buckets; d++){
+                auto total = size_t{0};
+                for(auto t = size_t{0}; t < threads; t++){
+                    auto const c = hist[t * radix_buckets + d];
+                    hist[t * radix_buckets + d] = off;
+                    off += c;
+                    total += c;
+                }
+                skip |= total == n;
+            }
+            if( skip ){
+                continue;
+            }
+
+            parallel::parallel_for(n, [&](size_t b, size_t e, size_t t){
+                auto* o = hist.data() + t * radix_buckets;
+                for(auto i = b; i < e; i++){
+                    auto const at = o[ ( src_k[i] >> shift ) & ( radix_buckets - 1u ) ]++;
+                    dst_k[at] = src_k[i];
+                    dst_v[at] = src_v[i];
+                }
+            }, threads);
+
+            src_k = dst_k;
+            src_v = dst_v;
+            dst_k = dst_k == ka.data() ? kb.data() : ka.data();
+            dst_v = dst_v == va.data() ? vb.data() : va.data();
+            sorted = true;
+        }
+
+        if( !sorted ){
+            parallel::parallel_for(n, [&](size_t b, size_t e, size_t){
+                std::copy(keys + b, keys + e, ka.data() + b);
+                std::copy(values + b, values + e, va.data() + b);
+            }, threads);
+            src_k = ka.data();
+        }
+        auto const in_a = src_k == ka.data();
+        out_keys = std::move( in_a ? ka : kb );
+        out_values = std::move( in_a ? va : vb );
+    }
+
+    /** @brief Positions i of [0, n) where a new run starts, i.e. i == 0 or !same(i - 1, i), in parallel */
+    template< typename Same >
+    index_array run_starts(size_t n, Same same, size_t threads){
+        threads = std::max<size_t>( 1, std::min(threads, n) );
+        auto counts = std::vector<size_t>(threads + 1u, 0);
+        parallel::parallel_for(n, [&](size_t b, size_t e, size_t t){
+            auto c = size_t{0};
+            for(auto i = b; i < e; i++){
+                c += i == 0u || !same(i - 1u, i);
+            }
+            counts[t + 1u] = c;
+        }, threads);
+        for(auto t = size_t{0}; t < threads; t++){
+            counts[t + 1u] += counts[t];
+        }
+
+        auto starts = index_array( counts.back() );
+        parallel::parallel_for(n, [&](size_t b, size_t e, size_t t){
+            auto o = counts[t];
+            for(auto i = b; i < e; i++){
+                if( i == 0u || !same(i - 1u, i) ){
+                    starts[o++] = i;
+                }
+            }
+        }, threads);
+        return starts;
+    }
+
+    /** @brief c[i] = lower_bound(fine, coarse[i]) for the subsequence coarse of fine, plus fine.size() */
+    inline index_array child_offsets(index_array const& coarse, index_array const& fine, size_t threads){
+        auto ptr = index_array( coarse.size() + 1u );
+        parallel::parallel_for(coarse.size(), [&](size_t b, size_t e, size_t){
+            auto it = fine.begin();
+            for(auto i = b; i < e; i++){
+                it = std::lower_bound(it, fine.end(), coarse[i]);
+                ptr[i] = size_t( it - fine.begin() );
+            }
+        }, threads);
+        ptr.back() = fine.size();
+        return ptr;
+    }
+
+}
+
+namespace storage_type::sparse_tensor{
+
+    /** @brief Sorts n coordinate entries by linear index and merges duplicates
+     *
+     * Duplicates are folded left to right in input order, v = combine(v, next), so the result is
+     * deterministic for any thread count. Sorting, merging and all output writes are parallel over
+     * static thread partitions; pages of the result are first touched by the thread that fills them.
+     *
+     * @code auto s = sort_entries( idx.data(), val.data(), idx.size(), e.product() );
+     * @code auto m = sort_entries( idx.data(), val.data(), idx.size(), e.product(), [](float a, float b){ return std::max(a,b); } );
+     *
+     * @param index linear indices, last index fastest
+     * @param values values of the entries
+     * @param n number of entries
+     * @param universe exclusive bound of the indices, e.g. the number of elements of the tensor
+     * @param combine binary operation merging values of equal indices, std::plus by default
+     * @param threads number of threads
+     */
+    template< typename T, typename Combine = std::plus<> >
+    sorted_entries<T> sort_entries(size_t const* index, T const* values, size_t n, size_t universe,
+                                   Combine combine = {}, size_t threads = parallel::concurrency())
+    {
+        auto timer = instrumentation::scoped_kernel("sort_entries", n * ( sizeof(size_t) + sizeof(T) ));
+        auto bad = std::vector<char>( std::max<size_t>( 1, std::min(threads, n) ), 0 );
+        parallel::parallel_for(n, [&](size_t b, size_t e, size_t t){
+            bad[t] = std::any_of(index + b, index + e, [universe](size_t k){ return k >= universe; });
+        }, threads);
+        if( std::find(bad.begin(), bad.end(), 1) != bad.end() ){
+            throw std::out_of_range("Error in sort_entries() : index out of range");
+        }
+
+        auto keys = index_array{};
+        auto vals = dense_tensor::uninitialized_vector<T>{};
+        detail::radix_sort(index, values, n, universe, threads, keys, vals);
+
+        auto const starts = detail::run_starts(n, [&](size_t a, size_t b){ return keys[a] == keys[b]; }, threads);
+        auto r = sorted_entries<T>{ index_array( starts.size() ), dense_tensor::uninitialized_vector<T>( starts.size() ) };
+        parallel::parallel_for(starts.size(), [&](size_t b, size_t e, size_t){
+            for(auto u = b; u < e; u++){
+                auto const first = starts[u];
+                auto const last = u + 1u < starts.size() ? starts[u + 1u] : n;
+                auto v = std::move(vals[first]);
+                for(auto i = first + 1u; i < last; i++){
+                    v = combine(std::move(v), vals[i]);
+                }
+                r.index[u] = keys[first];
+                r.values[u] = std::move(v);
+            }
+        }, threads);
+        return r;
+    }
+
+    /** @brief Builds the csr of a rows x cols matrix from its sorted entries, consuming them */
+    template< typename T >
+    csr<T> make_csr(sorted_entries<T>&& s, size_t rows, size_t cols, size_t threads = parallel::concurrency()){
+        if( !s.index.empty() && s.index.back() >= rows * cols ){
+            throw std::out_of_range("Error in make_csr() : index out of range");
+        }
+        auto timer = instrumentation::scoped_kernel("make_csr", s.index.size() * sizeof(size_t));
+
+        auto r = csr<T>{ rows, cols, index_array( rows + 1u ), std::move(s.index), std::move(s.values) };
+        parallel::parallel_for(rows + 1u, [&](size_t b, size_t e, size_t){
+            auto it = r.col_index.begin();
+            for(auto i = b; i < e; i++){
+                it = std::lower_bound(it, r.col_index.end(), i * cols);
+                r.row_ptr[i] = size_t( it - r.col_index.begin() );
+            }
+        }, threads);
+
+        // without columns there are no entries to split, and a divisor must not be zero
+        auto const d = mdspan::detail::fast_divisor<63>( static_cast<std::uint64_t>( std::max<size_t>(cols, 1u) ) );
+        parallel::parallel_for(r.col_index.size(), [&](size_t b, size_t e, size_t){
+            for(auto i = b; i < e; i++){
+                auto const k = r.col_index[i];
+                r.col_index[i] = static_cast<size_t>( k - d.divide(k) * cols );
+            }
+        }, threads);
+        return r;
+    }
+
+    /** @brief Builds the csf of a tensor with extents e from its sorted entries, consuming them */
+    template< typename T, ptrdiff_t D, ptrdiff_t ... E >
+    csf<T> make_csf(sorted_entries<T>&& s, mdspan::extents<D,E...> const& e, size_t threads = parallel::concurrency()){
+        auto const ext = mdspan::to_dynamic(e).base();
+        auto const rank = ext.size();
+        if( rank == 0u ){
+            throw std::length_error("Error in make_csf() : rank must be positive");
+        }
+        auto const universe = static_cast<size_t>( e.product() );
+        if( !s.index.empty() && s.index.back() >= universe ){
+            throw std::out_of_range("Error in make_csf() : index out of range");
+        }
+        auto timer = instrumentation::scoped_kernel("make_csf", rank * s.index.size() * sizeof(size_t));
+
+        // prefix (i_0, ..., i_l) of a linear index k is k / stride[l], and i_l that modulo ext[l]
+        auto const stride = mdspan::row_major_strides(e);
+        auto div = std::vector<mdspan::detail::fast_divisor<63>>{};
+        auto mod = std::vector<mdspan::detail::fast_divisor<63>>{};
+        for(auto l = size_t{0}; l < rank; l++){
+            div.emplace_back( static_cast<std::uint64_t>(stride[l]) );
+            mod.emplace_back( static_cast<std::uint64_t>(ext[l]) );
+        }
+
+        auto const& key = s.index;
+        auto const n = key.size();
+        auto r = csf<T>{ ext, std::vector<index_array>( rank - 1u ), std::vector<index_array>(rank), {} };
+
+        // starts of the fibers of level l, computed from the finest level up
+        auto fine = index_array{};
+        for(auto l = rank; l-- > 0u;){
+            auto const& dl = div[l];
+            auto const& ml = mod[l];
+            auto starts = l + 1u == rank ? index_array{}
+                                         : detail::run_starts(n, [&](size_t a, size_t b){ return dl.divide(key[a]) == dl.divide(key[b]); }, threads);
+            auto const count = l + 1u == rank ? n : starts.size();
+
+            auto& ids = r.fids[l];
+            ids = index_array(count);
+            parallel::parallel_for(count, [&](size_t b, size_t end, size_t){
+                for(auto f = b; f < end; f++){
+                    auto const p = dl.divide( key[ l + 1u == rank ? f : starts[f] ] );
+                    ids[f] = static_cast<size_t>( p - ml.divide(p) * ml.divisor() );
+                }
+            }, threads);
+
+            if( l + 1u < rank ){
+                if( l + 2u == rank ){
+                    // the last level is one fiber per entry, so children start at the run starts themselves
+                    r.fptr[l] = index_array( starts.size() + 1u );
+                    std::copy(starts.begin(), starts.end(), r.fptr[l].begin());
+                    r.fptr[l].back() = n;
+                }else{
+                    r.fptr[l] = detail::child_offsets(starts, fine, threads);
+                }
+            }
+            fine = std::move(starts);
+        }
+        r.values = std::move(s.values);
+        return r;
+    }
+
+    /** @brief Adopts sorted entries as map_compression storage of a tensor with n elements */
+    template< typename T >
+    map_compression<T> make_map_compression(sorted_entries<T>&& s, size_t n){
+        return map_compression<T>( std::move(s.index), std::move(s.values), n );
+    }
+
+}
+
+#endif // SPARSE_BUILDER_H
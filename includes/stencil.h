@@ -0,0 +1,314 @@
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include "tensor.h"
+#include "parallel.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+namespace test{
+
+    /** @brief Value of a neighbour that lies outside the tensor */
+    enum class boundary{
+        clamp,      // the nearest element inside, i.e. the edge is repeated
+        periodic,   // the element on the opposite side, i.e. the tensor wraps around
+        zero        // zero, i.e. the neighbour does not contribute
+    };
+
+    /** @brief Neighbourhood with a run-time number of points: offsets from the centre and their weights
+     *
+     * @code auto n = neighbourhood<float>(2); n.add({0,-1}, .25f); n.add({0,1}, .25f); ...
+     */
+    template< typename T >
+    struct neighbourhood{
+        using value_type = T;
+
+        explicit neighbourhood(size_t rank)
+            : _rank(rank){}
+
+        /** @brief Adds the point at offset with weight w; offset has rank() entries */
+        void add(std::initializer_list<ptrdiff_t> offset, T w){
+            assert( offset.size() == _rank );
+            add(offset.begin(), w);
+        }
+
+        template< typename I >
+        void add(I const* offset, T w){
+            _offsets.insert(_offsets.end(), offset, offset + _rank);
+            _weights.push_back(std::move(w));
+        }
+
+        size_t rank() const noexcept{ return _rank; }
+        size_t size() const noexcept{ return _weights.size(); }
+        ptrdiff_t offset(size_t p, size_t k) const noexcept{ return _offsets[p * _rank + k]; }
+        T const& weight(size_t p) const noexcept{ return _weights[p]; }
+
+    private:
+        size_t _rank;
+        std::vector<ptrdiff_t> _offsets;
+        std::vector<T> _weights;
+    };
+
+    /** @brief Neighbourhood of N points known at compile time, so the stencil loops unroll over it
+     *
+     * @code constexpr auto lap = star_stencil<float,3>(-6.f, 1.f);
+     */
+    template< typename T, size_t Rank, size_t N >
+    struct fixed_neighbourhood{
+        using value_type = T;
+
+        std::array<std::array<ptrdiff_t, Rank>, N> offsets{};
+        std::array<T, N> weights{};
+
+        static constexpr size_t rank() noexcept{ return Rank; }
+        static constexpr size_t size() noexcept{ return N; }
+        constexpr ptrdiff_t offset(size_t p, size_t k) const noexcept{ return offsets[p][k]; }
+        constexpr T const& weight(size_t p) const noexcept{ return weights[p]; }
+    };
+
+    /** @brief The 2 Rank + 1 point star: weight centre at the centre, arm at its direct neighbours
+     *
+     * @code star_stencil<double,2>(-4., 1.) is the 5-point Laplacian
+     */
+    template< typename T, size_t Rank >
+    constexpr fixed_neighbourhood<T, Rank, 2u * Rank + 1u> star_stencil(T centre, T arm){
+        auto n = fixed_neighbourhood<T, Rank, 2u * Rank + 1u>{};
+        n.weights[0] = centre;
+        for(auto k = size_t{0}; k < Rank; k++){
+            n.offsets[2u * k + 1u][k] = -1;
+            n.offsets[2u * k + 2u][k] = 1;
+            n.weights[2u * k + 1u] = arm;
+            n.weights[2u * k + 2u] = arm;
+        }
+        return n;
+    }
+
+    /** @brief Neighbourhood of a dense kernel tensor whose element x sits at offset x - extent / 2
+     *
+     * With flip the offsets are negated, turning the correlation of stencil() into a convolution.
+     */
+    template< typename T, typename E, typename F, typename A >
+    neighbourhood<T> make_neighbourhood(tensor<T,E,F,A> const& kernel, bool flip = false){
+        auto const& e = kernel.extents();
+        auto const r = static_cast<size_t>( e.rank() );
+        auto n = neighbourhood<T>(r);
+        auto idx = std::vector<ptrdiff_t>(r, 0);
+        auto off = std::vector<ptrdiff_t>(r);
+        auto const* p = kernel.data();
+        for(auto i = size_t{0}; i < kernel.size(); i++){
+            for(auto k = size_t{0}; k < r; k++){
+                off[k] = ( idx[k] - static_cast<ptrdiff_t>( e.extent(k) ) / 2 ) * ( flip ? -1 : 1 );
+            }
+            if( p[i] != T{} ){
+                n.add(off.data(), p[i]);
+            }
+            for(auto k = r; k-- > 0u;){
+                if( ++idx[k] < static_cast<ptrdiff_t>( e.extent(k) ) ) break;
+                idx[k] = 0;
+            }
+        }
+        return n;
+    }
+
+}
+
+namespace test::detail{
+
+    /** @brief Innermost elements per work unit of stencil(); one tile of output stays in L1 across all points */
+    constexpr ptrdiff_t stencil_tile = 512;
+
+    inline ptrdiff_t stencil_wrap(ptrdiff_t y, ptrdiff_t n, boundary bc) noexcept{
+        if( bc == boundary::clamp ){
+            return std::clamp<ptrdiff_t>(y, 0, n - 1);
+        }
+        y %= n;
+        return y < 0 ? y + n : y;
+    }
+
+    /** @brief Element at multi-index x, every neighbour resolved through the boundary policy */
+    template< typename T, typename N >
+    T stencil_point(T const* in, N const& nb, ptrdiff_t const* x, ptrdiff_t const* n, ptrdiff_t const* s, boundary bc){
+        auto acc = T{};
+        for(auto p = size_t{0}; p < nb.size(); p++){
+            auto off = ptrdiff_t{0};
+            auto inside = true;
+            for(auto k = size_t{0}; k < nb.rank(); k++){
+                auto y = x[k] + nb.offset(p, k);
+                if( y < 0 || y >= n[k] ){
+                    if( bc == boundary::zero ){
+                        inside = false;
+                        break;
+                    }
+                    y = stencil_wrap(y, n[k], bc);
+                }
+                off += y * s[k];
+            }
+            if( inside ){
+                acc += T( nb.weight(p) ) * in[off];
+            }
+        }
+        return acc;
+    }
+
+    /** @brief out[i] = sum_p w_p in[i + d_p] for i in [0, len), all neighbours inside the tensor
+     *
+     * The points are the outer loop, so each pass is a unit-stride loop the compiler vectorizes;
+     * len is at most one tile, which keeps out in L1 between the passes.
+     */
+    template< typename T, typename N >
+    void stencil_interior(T const* in, T* out, ptrdiff_t len, N const& nb, ptrdiff_t const* delta){
+        auto const w0 = T( nb.weight(0) );
+        auto const* p0 = in + delta[0];
+        for(auto i = ptrdiff_t{0}; i < len; i++){
+            out[i] = w0 * p0[i];
+        }
+        for(auto p = size_t{1}; p < nb.size(); p++){
+            auto const w = T( nb.weight(p) );
+            auto const* q = in + delta[p];
+            for(auto i = ptrdiff_t{0}; i < len; i++){
+                out[i] += w * q[i];
+            }
+        }
+    }
+
+}
+
+namespace test{
+
+    /** @brief out(x) = sum_p weight(p) a(x + offset(p)) for every multi-index x (a correlation)
+     *
+     * Neighbours outside a are taken from the boundary policy bc. The innermost mode is cut into
+     * tiles and every (row, tile) pair is a work unit of parallel::parallel_for. Each tile is split
+     * into an interior part, where every neighbour is inside and the kernel runs without bounds
+     * checks as unit-stride loops over precomputed linear offsets, and the remaining boundary
+     * elements, which resolve every neighbour through bc. A row whose outer indices are within the
+     * halo of an outer face has boundary elements only.
+     *
+     * @code auto out = tensor<float, dims<dynamic_dims>>( a.extents(), storage_type::uninitialized );
+     * @code stencil( a, star_stencil<float,3>(-6.f, 1.f), out, boundary::periodic );
+     *
+     * @param a input, dense with row-major layout
+     * @param nb neighbourhood, a neighbourhood or fixed_neighbourhood of rank a.rank()
+     * @param out output of the extents of a; must not alias a
+     * @param bc boundary policy
+     */
+    template< typename T, typename EA, typename FA, typename AA, typename N, typename EO, typename FO, typename AO >
+    void stencil(tensor<T,EA,FA,AA> const& a, N const& nb, tensor<T,EO,FO,AO>& out, boundary bc = boundary::zero,
+                 size_t threads = parallel::concurrency())
+    {
+        auto const& e = a.extents();
+        auto const r = static_cast<size_t>( e.rank() );
+        if( nb.rank() != r ){
+            throw std::length_error("Error in stencil() : rank of neighbourhood and tensor differ");
+        }
+        if( out.size() != a.size() ){
+            throw std::length_error("Error in stencil() : sizes of input and output differ");
+        }
+        assert( static_cast<void const*>( a.data() ) != static_cast<void const*>( out.data() ) );
+
+        auto timer = instrumentation::scoped_kernel("stencil", 2u * a.size() * sizeof(T));
+        if( a.size() == 0u ){
+            return;
+        }
+        auto* q = out.data();
+        auto const* in = a.data();
+        if( r == 0u || nb.size() == 0u ){
+            auto const v = r == 0u ? detail::stencil_point(in, nb, nullptr, nullptr, nullptr, bc) : T{};
+            std::fill(q, q + out.size(), v);
+            return;
+        }
+
+        // extents, strides, halo widths and linear offsets of the points
+        auto n = std::vector<ptrdiff_t>(r);
+        auto s = std::vector<ptrdiff_t>(r);
+        auto lo = std::vector<ptrdiff_t>(r, 0);
+        auto hi = std::vector<ptrdiff_t>(r, 0);
+        for(auto k = r; k-- > 0u;){
+            n[k] = static_cast<ptrdiff_t>( e.extent(k) );
+            s[k] = k + 1u == r ? 1 : s[k + 1u] * n[k + 1u];
+        }
+        auto delta = std::vector<ptrdiff_t>( nb.size(), 0 );
+        for(auto p = size_t{0}; p < nb.size(); p++){
+            for(auto k = size_t{0}; k < r; k++){
+                auto const o = nb.offset(p, k);
+                lo[k] = std::max(lo[k], -o);
+                hi[k] = std::max(hi[k], o);
+                delta[p] += o * s[k];
+            }
+        }
+
+        auto const last = r - 1u;
+        auto const inner = n[last];
+        auto const tiles = ( inner + detail::stencil_tile - 1 ) / detail::stencil_tile;
+        auto const rows = a.size() / static_cast<size_t>(inner);
+        // interior of the innermost mode, empty if the halo covers the whole row
+        auto const i_lo = std::min(lo[last], inner);
+        auto const i_hi = std::max(i_lo, inner - hi[last]);
+
+        parallel::parallel_for(rows * static_cast<size_t>(tiles), [&](size_t b, size_t end, size_t){
+            auto x = std::vector<ptrdiff_t>(r);
+            for(auto u = b; u < end; u++){
+                auto row = u / static_cast<size_t>(tiles);
+                auto const t0 = static_cast<ptrdiff_t>( u % static_cast<size_t>(tiles) ) * detail::stencil_tile;
+                auto const t1 = std::min(t0 + detail::stencil_tile, inner);
+
+                auto base = ptrdiff_t{0};
+                auto interior_row = true;
+                for(auto k = last; k-- > 0u;){
+                    x[k] = static_cast<ptrdiff_t>( row % static_cast<size_t>( n[k] ) );
+                    row /= static_cast<size_t>( n[k] );
+                    base += x[k] * s[k];
+                    interior_row = interior_row && x[k] >= lo[k] && x[k] < n[k] - hi[k];
+                }
+
+                auto boundary_part = [&](ptrdiff_t i0, ptrdiff_t i1){
+                    for(auto i = i0; i < i1; i++){
+                        x[last] = i;
+                        q[base + i] = detail::stencil_point(in, nb, x.data(), n.data(), s.data(), bc);
+                    }
+                };
+
+                if( !interior_row ){
+                    boundary_part(t0, t1);
+                    continue;
+                }
+                auto const c0 = std::clamp(i_lo, t0, t1);
+                auto const c1 = std::clamp(i_hi, c0, t1);
+                boundary_part(t0, c0);
+                if( c1 > c0 ){
+                    detail::stencil_interior(in + base + c0, q + base + c0, c1 - c0, nb, delta.data());
+                }
+                boundary_part(c1, t1);
+            }
+        }, threads);
+    }
+
+    /** @brief Returns the stencil of a in a new tensor of the type of a */
+    template< typename T, typename E, typename F, typename A, typename N >
+    tensor<T,E,F,A> stencil(tensor<T,E,F,A> const& a, N const& nb, boundary bc = boundary::zero,
+                            size_t threads = parallel::concurrency())
+    {
+        auto out = tensor<T,E,F,A>( a.extents(), storage_type::uninitialized );
+        stencil(a, nb, out, bc, threads);
+        return out;
+    }
+
+    /** @brief N-d convolution of a with a dense kernel centred at extent / 2 in every mode
+     *
+     * @code auto blurred = convolve( image, gauss, boundary::clamp );
+     */
+    template< typename T, typename E, typename F, typename A, typename EK, typename FK, typename AK >
+    tensor<T,E,F,A> convolve(tensor<T,E,F,A> const& a, tensor<T,EK,FK,AK> const& kernel, boundary bc = boundary::zero,
+                             size_t threads = parallel::concurrency())
+    {
+        return stencil(a, make_neighbourhood(kernel, true), bc, threads);
+    }
+
+}
+
+#endif // STENCIL_H
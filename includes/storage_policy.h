@@ -2,9 +2,54 @@
 #define STORAGE_POLICY_H
 
 #include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
 #include "mdspan.h"
+#include "instrumentation.h"
 
 namespace storage_type{
+    namespace dense_tensor{
+
+        /** @brief Allocator adaptor that default-initializes instead of value-initializing
+         *
+         * std::vector<T, default_init_allocator<T>>(n) leaves trivially constructible elements
+         * uninitialized instead of zero-filling them.
+         */
+        template < typename T, typename A = std::allocator<T> >
+        struct default_init_allocator : A{
+            using traits = std::allocator_traits<A>;
+
+            template < typename U >
+            struct rebind{
+                using other = default_init_allocator< U, typename traits::template rebind_alloc<U> >;
+            };
+
+            using A::A;
+
+            default_init_allocator() = default;
+
+            template < typename U >
+            void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>){
+                ::new(static_cast<void*>(p)) U;
+            }
+
+            template < typename U, typename ... Args >
+            void construct(U* p, Args&& ... args){
+                traits::construct(static_cast<A&>(*this), p, std::forward<Args>(args)...);
+            }
+        };
+
+        template < typename T >
+        using uninitialized_vector = std::vector< T, default_init_allocator<T> >;
+
+    }
+
     namespace sparse_tensor{
         
         template< typename T >
@@ -16,18 +61,262 @@ namespace storage_type{
             virtual T get(size_t) = 0;
         };
 
+        /** @brief Offset table over the strictly increasing indices of compressed sparse storage
+         *
+         * The index universe is cut into buckets of 2^shift consecutive indices, with shift chosen so
+         * that there are about as many buckets as stored indices; offset[b] is the position of the
+         * first index in bucket b or later. A lookup reads two offsets and scans the few indices of
+         * one bucket, O(1) on average instead of the log2(nnz) dependent loads of a binary search;
+         * buckets that are crowded by clustered indices fall back to a binary search of the bucket.
+         * The table holds 32-bit offsets, about 4 bytes per stored element; with more than 2^32 - 1
+         * elements it stays empty and lookups are binary searches of the whole array.
+         *
+         * The table does not own the indices; it is rebuilt whenever they change.
+         */
+        struct index_table{
+            static constexpr size_t npos = size_t(-1);
+
+            index_table() = default;
+
+            template< typename I >
+            explicit index_table(I const& index){
+                auto const n = index.size();
+                if( n == 0u || n >= size_t( std::numeric_limits<std::uint32_t>::max() ) ){
+                    return;
+                }
+                auto const universe = index.back() + 1u;
+                while( _shift < 63u && ( universe >> _shift ) > n ){
+                    _shift++;
+                }
+                auto const buckets = ( index.back() >> _shift ) + 1u;
+                _offset.resize(buckets + 1u);
+                auto pos = size_t{0};
+                for(auto b = size_t{0}; b <= buckets; b++){
+                    while( pos < n && ( index[pos] >> _shift ) < b ){
+                        pos++;
+                    }
+                    _offset[b] = static_cast<std::uint32_t>(pos);
+                }
+            }
+
+            /** @brief Position of k in index, or npos */
+            template< typename I >
+            size_t find(I const& index, size_t k) const noexcept{
+                if( _offset.empty() ){
+                    return search(index, 0, index.size(), k);
+                }
+                // b + 1 would wrap for k == SIZE_MAX when shift is 0
+                auto const b = k >> _shift;
+                if( b >= _offset.size() - 1u ){
+                    return npos;
+                }
+                return search(index, _offset[b], _offset[b + 1u], k);
+            }
+
+            /** @brief pos[i] = find(index, keys[i]) for i in [0, n)
+             *
+             * Keys are handled in groups whose offsets, then first indices, are prefetched before any
+             * of them is searched, so the cache misses of a group overlap instead of serializing.
+             */
+            template< typename I >
+            void find(I const& index, size_t const* keys, size_t n, size_t* pos) const noexcept{
+                constexpr auto group = size_t{32};
+                size_t lo[group], hi[group];
+                for(auto g = size_t{0}; g < n; g += group){
+                    auto const m = std::min(group, n - g);
+                    if( _offset.empty() ){
+                        for(auto i = size_t{0}; i < m; i++){
+                            pos[g + i] = search(index, 0, index.size(), keys[g + i]);
+                        }
+                        continue;
+                    }
+#if defined(__GNUC__)
+                    for(auto i = size_t{0}; i < m; i++){
+                        auto const b = std::min( keys[g + i] >> _shift, _offset.size() - 1u );
+                        __builtin_prefetch( _offset.data() + b );
+                    }
+#endif
+                    for(auto i = size_t{0}; i < m; i++){
+                        auto const b = keys[g + i] >> _shift;
+                        auto const in = b < _offset.size() - 1u;
+                        lo[i] = in ? _offset[b] : 0u;
+                        hi[i] = in ? _offset[b + 1u] : 0u;
+#if defined(__GNUC__)
+                        if( lo[i] < hi[i] ){
+                            __builtin_prefetch( index.data() + lo[i] );
+                        }
+#endif
+                    }
+                    for(auto i = size_t{0}; i < m; i++){
+                        pos[g + i] = search(index, lo[i], hi[i], keys[g + i]);
+                    }
+                }
+            }
+
+            size_t shift() const noexcept{ return _shift; }
+            size_t buckets() const noexcept{ return _offset.empty() ? 0u : _offset.size() - 1u; }
+
+        private:
+            template< typename I >
+            static size_t search(I const& index, size_t lo, size_t hi, size_t k) noexcept{
+                if( hi - lo <= 8u ){
+                    for(auto i = lo; i < hi; i++){
+                        if( index[i] >= k ){
+                            return index[i] == k ? i : npos;
+                        }
+                    }
+                    return npos;
+                }
+                auto const it = std::lower_bound(index.begin() + ptrdiff_t(lo), index.begin() + ptrdiff_t(hi), k);
+                return it != index.begin() + ptrdiff_t(hi) && *it == k ? size_t( it - index.begin() ) : npos;
+            }
+
+            std::vector<std::uint32_t> _offset;
+            size_t _shift{0};
+        };
+
+        /** @brief Sparse storage as sorted (index, value) arrays plus a hash map of pending insertions
+         *
+         * set() of an index that is not stored yet goes to the hash map; compress() merges the map into
+         * the sorted arrays and rebuilds their index_table, after which at() and get() are O(1) on
+         * average and gather() reads many elements at once. Indices are linear, last index fastest.
+         * Unset elements read as T{}.
+         */
         template< typename T>
         struct map_compression: storage_interface<T>{
-            void compress() override {}
+            using index_array = dense_tensor::uninitialized_vector<size_t>;
+            using value_array = dense_tensor::uninitialized_vector<T>;
+
+            map_compression() = default;
+
+            /** @param n number of elements of the dense tensor, the length of uncompress() */
+            explicit map_compression(size_t n)
+                : _n(n){}
+
+            /** @brief Adopts strictly increasing indices and their values, e.g. from sort_entries() */
+            map_compression(index_array index, value_array values, size_t n)
+                : _index(std::move(index)), _values(std::move(values)), _n(n)
+            {
+                if( _index.size() != _values.size() ){
+                    throw std::length_error("Error in map_compression() : index and value arrays differ in length");
+                }
+                _table = index_table(_index);
+            }
+
+            void compress() override {
+                instrumentation::count(instrumentation::counter::sparse_compress);
+                if( _m.empty() ){
+                    return;
+                }
+
+                auto pending = std::vector<std::pair<size_t,T>>( _m.begin(), _m.end() );
+                std::sort(pending.begin(), pending.end(), [](auto const& a, auto const& b){ return a.first < b.first; });
+                _m.clear();
 
-            std::vector<T> uncompress() override {return {};}
+                auto index = index_array( _index.size() + pending.size() );
+                auto values = value_array( index.size() );
+                auto i = size_t{0}, j = size_t{0}, o = size_t{0};
+                while( i < _index.size() || j < pending.size() ){
+                    if( j == pending.size() || ( i < _index.size() && _index[i] < pending[j].first ) ){
+                        index[o] = _index[i];
+                        values[o++] = std::move(_values[i++]);
+                    }else{
+                        index[o] = pending[j].first;
+                        values[o++] = std::move(pending[j++].second);
+                    }
+                }
+                _index = std::move(index);
+                _values = std::move(values);
+                _table = index_table(_index);
+            }
+
+            std::vector<T> uncompress() override {
+                auto n = _n;
+                if( n == 0 ){
+                    n = _index.empty() ? 0 : _index.back() + 1u;
+                    for(auto const& [k, v] : _m){
+                        n = std::max(n, k + 1u);
+                    }
+                }
+                auto r = std::vector<T>(n);
+                for(auto i = size_t{0}; i < _index.size(); i++){
+                    r[_index[i]] = _values[i];
+                }
+                for(auto const& [k, v] : _m){
+                    r[k] = v;
+                }
+                return r;
+            }
             
-            T at(size_t) const override{return 0;}
+            T at(size_t k) const override{
+                instrumentation::count(instrumentation::counter::sparse_at);
+                return find(k);
+            }
+
+            void set(T v, size_t k) override{
+                instrumentation::count(instrumentation::counter::sparse_set);
+                auto const p = _table.find(_index, k);
+                if( p != index_table::npos ){
+                    _values[p] = std::move(v);
+                }else{
+                    _m[k] = std::move(v);
+                }
+            }
+            T get(size_t k) override{
+                instrumentation::count(instrumentation::counter::sparse_get);
+                return find(k);
+            }
+
+            /** @brief Number of stored elements */
+            size_t nnz() const noexcept{ return _index.size() + _m.size(); }
+
+            /** @brief True if no insertion is pending, i.e. index() and values() hold every stored element */
+            bool compressed() const noexcept{ return _m.empty(); }
+
+            /** @brief out[i] = at(keys[i]) for i in [0, n), with the lookups of neighbouring keys overlapped */
+            void gather(size_t const* keys, size_t n, T* out) const{
+                instrumentation::count(instrumentation::counter::sparse_at, n);
+                constexpr auto group = size_t{256};
+                size_t pos[group];
+                for(auto g = size_t{0}; g < n; g += group){
+                    auto const m = std::min(group, n - g);
+                    _table.find(_index, keys + g, m, pos);
+#if defined(__GNUC__)
+                    for(auto i = size_t{0}; i < m; i++){
+                        if( pos[i] != index_table::npos ){
+                            __builtin_prefetch( _values.data() + pos[i] );
+                        }
+                    }
+#endif
+                    for(auto i = size_t{0}; i < m; i++){
+                        out[g + i] = pos[i] != index_table::npos ? _values[ pos[i] ] : pending(keys[g + i]);
+                    }
+                }
+            }
+
+            index_array const& index() const noexcept{ return _index; }
+            value_array const& values() const noexcept{ return _values; }
+            index_table const& table() const noexcept{ return _table; }
 
-            void set(T, size_t) override{}
-            T get(size_t) override{return T{};}
         private:
+            T find(size_t k) const{
+                auto const p = _table.find(_index, k);
+                return p != index_table::npos ? _values[p] : pending(k);
+            }
+
+            T pending(size_t k) const{
+                if( _m.empty() ){
+                    return T{};
+                }
+                auto const jt = _m.find(k);
+                return jt == _m.end() ? T{} : jt->second;
+            }
+
+            index_array _index;
+            value_array _values;
+            index_table _table;
             std::unordered_map<size_t,T> _m;
+            size_t _n{0};
         };
 
     }
@@ -44,15 +333,301 @@ namespace storage_type{
 
         template < typename T, typename A >
         struct dense:storage_interface<T>{
-            T& at(size_t) override {return _m[0];};
-            T at(size_t) const override{return _m[0];};
-            void set(T, size_t) override{};
-            T get(T, size_t) override{return at(0);};
-            std::vector<T> _m;
+            dense() = default;
+
+            explicit dense(A data)
+                : _m(std::move(data)){}
+
+            T& at(size_t k) override {
+                instrumentation::count(instrumentation::counter::dense_at);
+                return _m[k];
+            };
+            T at(size_t k) const override{
+                instrumentation::count(instrumentation::counter::dense_at);
+                return _m[k];
+            };
+            void set(T v, size_t k) override{
+                instrumentation::count(instrumentation::counter::dense_set);
+                _m[k] = std::move(v);
+            };
+            T get(T, size_t k) override{return _m[k];};
+
+            T* data() noexcept {return _m.data();}
+            T const* data() const noexcept {return _m.data();}
+            size_t size() const noexcept {return _m.size();}
+
+            A _m;
+        };
+
+        namespace detail{
+
+            template < typename A >
+            struct shared_block{
+                explicit shared_block(A data) : refs(1), data(std::move(data)){}
+                std::atomic<size_t> refs;
+                bool shareable{true};
+                A data;
+            };
+
+        }
+
+        /** @brief Dense storage whose buffer is shared between copies and copied on first mutation
+         *
+         * Copying a shared_dense only increments an atomic reference count. Every non-const access
+         * (at, set, data) first detaches, i.e. deep-copies the buffer if it is referenced by another
+         * shared_dense, so read-only copies handed to other pipeline stages never duplicate the data.
+         * Once the non-const at() or data() has handed out a reference into the buffer, the buffer is
+         * no longer shareable: later copies are deep, so writes through that reference stay private.
+         * Reads should therefore go through the const members, e.g. via as_const() or
+         * test::tensor::as_const(), which neither detach nor stop the sharing.
+         * A moved-from shared_dense is empty.
+         *
+         * @code auto a = shared_dense<float>( std::vector<float>(n) );
+         * @code auto b = a;          // shares the buffer
+         * @code b.set(1.f, 0);       // b detaches, a is unchanged
+         * @code float x = b.as_const().at(0); // reads keep b shareable
+         * @code float& r = b.at(0);  // b is no longer shared with new copies
+         *
+         * @note the reference count is thread-safe; a single shared_dense object is not
+         *
+         * @tparam T value type
+         * @tparam A contiguous container type holding the elements
+         */
+        template < typename T, typename A = std::vector<T> >
+        struct shared_dense:storage_interface<T>{
+            using base_type = A;
+            using block_type = detail::shared_block<A>;
+
+            shared_dense()
+                : _b(new block_type(A{})){}
+
+            explicit shared_dense(A data)
+                : _b(new block_type(std::move(data))){}
+
+            shared_dense(shared_dense const& other)
+                : _b(other._b)
+            {
+                if( _b == nullptr ){
+                    return;
+                }
+                if( !_b->shareable ){
+                    instrumentation::allocation(instrumentation::counter::storage_allocations, size() * sizeof(T));
+                    _b = new block_type(other._b->data);
+                    return;
+                }
+                _b->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            shared_dense(shared_dense&& other) noexcept
+                : _b(std::exchange(other._b, nullptr)){}
+
+            shared_dense& operator=(shared_dense other) noexcept{
+                std::swap(_b, other._b);
+                return *this;
+            }
+
+            ~shared_dense(){
+                release();
+            }
+
+            T& at(size_t k) override {
+                instrumentation::count(instrumentation::counter::dense_at);
+                detach();
+                _b->shareable = false;
+                return _b->data[k];
+            }
+
+            T at(size_t k) const override{
+                instrumentation::count(instrumentation::counter::dense_at);
+                return _b->data[k];
+            }
+
+            void set(T v, size_t k) override{
+                instrumentation::count(instrumentation::counter::dense_set);
+                detach();
+                _b->data[k] = std::move(v);
+            }
+
+            T get(T, size_t k) override{
+                return _b->data[k];
+            }
+
+            T const* data() const noexcept{
+                return _b == nullptr ? nullptr : _b->data.data();
+            }
+
+            T* data(){
+                detach();
+                _b->shareable = false;
+                return _b->data.data();
+            }
+
+            size_t size() const noexcept{
+                return _b == nullptr ? 0u : _b->data.size();
+            }
+
+            /** @brief Returns this as const, so at() and data() read without detaching */
+            shared_dense const& as_const() const noexcept{
+                return *this;
+            }
+
+            /** @brief Returns true if no other shared_dense references this buffer */
+            bool unique() const noexcept{
+                return use_count() <= 1u;
+            }
+
+            size_t use_count() const noexcept{
+                return _b == nullptr ? 0u : _b->refs.load(std::memory_order_acquire);
+            }
+
+            /** @brief Returns a shared_dense owning a deep copy of the buffer */
+            shared_dense clone() const{
+                if( _b == nullptr ){
+                    return shared_dense();
+                }
+                instrumentation::allocation(instrumentation::counter::storage_allocations, size() * sizeof(T));
+                return shared_dense(_b->data);
+            }
+
+            /** @brief Makes this the only owner of its buffer, copying it if it is shared */
+            void detach(){
+                if( _b == nullptr ){
+                    _b = new block_type(A{});
+                }else if( !unique() ){
+                    instrumentation::allocation(instrumentation::counter::storage_allocations, size() * sizeof(T));
+                    auto* b = new block_type(_b->data);
+                    release();
+                    _b = b;
+                }
+            }
+
+        private:
+            void release() noexcept{
+                if( _b != nullptr && _b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1 ){
+                    delete _b;
+                }
+                _b = nullptr;
+            }
+
+            block_type* _b;
         };
 
     }
 
+    /** @brief Tag selecting construction without initializing the elements
+     *
+     * @note only honoured by containers whose allocator default-initializes, e.g.
+     * dense_tensor::uninitialized_vector; other containers fall back to value-initialization.
+     */
+    struct uninitialized_t{ explicit uninitialized_t() = default; };
+    inline constexpr uninitialized_t uninitialized{};
+
+    /** @brief Tag selecting construction with value-initialized (zeroed) elements */
+    struct value_initialized_t{ explicit value_initialized_t() = default; };
+    inline constexpr value_initialized_t value_initialized{};
+
+    /** @brief Constructs a storage of n elements in a single allocation
+     *
+     * The primary template handles contiguous containers such as std::vector; the
+     * specializations for the storage policies build the container they wrap.
+     *
+     * @tparam S storage or container type
+     */
+    template< typename S >
+    struct storage_traits{
+        using value_type = typename S::value_type;
+
+        static constexpr bool default_initializes =
+            !std::is_same_v< typename S::allocator_type, std::allocator<value_type> >;
+
+        static S make(size_t n, uninitialized_t){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(value_type));
+            return S(n);
+        }
+
+        static S make(size_t n, value_initialized_t){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(value_type));
+            return S(n, value_type{});
+        }
+
+        static S make(size_t n, value_type const& v){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(value_type));
+            return S(n, v);
+        }
+
+        /** @brief Sets element k to gen(k) in one pass without pre-initializing the buffer */
+        template< typename F >
+        static S generate(size_t n, F&& gen){
+            instrumentation::allocation(instrumentation::counter::storage_allocations, n * sizeof(value_type));
+            if constexpr( default_initializes ){
+                auto s = S(n);
+                auto* p = s.data();
+                for(auto k = size_t{0}; k < n; k++){
+                    p[k] = gen(k);
+                }
+                return s;
+            }else{
+                auto s = S{};
+                s.reserve(n);
+                for(auto k = size_t{0}; k < n; k++){
+                    s.emplace_back(gen(k));
+                }
+                return s;
+            }
+        }
+    };
+
+    template< typename T, typename A >
+    struct storage_traits< dense_tensor::dense<T,A> >{
+        using value_type = T;
+
+        template< typename ... Args >
+        static auto make(size_t n, Args&& ... args){
+            return dense_tensor::dense<T,A>( storage_traits<A>::make(n, std::forward<Args>(args)...) );
+        }
+
+        template< typename F >
+        static auto generate(size_t n, F&& gen){
+            return dense_tensor::dense<T,A>( storage_traits<A>::generate(n, std::forward<F>(gen)) );
+        }
+    };
+
+    template< typename T, typename A >
+    struct storage_traits< dense_tensor::shared_dense<T,A> >{
+        using value_type = T;
+
+        template< typename ... Args >
+        static auto make(size_t n, Args&& ... args){
+            return dense_tensor::shared_dense<T,A>( storage_traits<A>::make(n, std::forward<Args>(args)...) );
+        }
+
+        template< typename F >
+        static auto generate(size_t n, F&& gen){
+            return dense_tensor::shared_dense<T,A>( storage_traits<A>::generate(n, std::forward<F>(gen)) );
+        }
+    };
+
+    template< typename T >
+    struct storage_traits< sparse_tensor::map_compression<T> >{
+        using value_type = T;
+
+        /** @brief Sparse storage holds no elements up front; sizing allocates nothing */
+        static auto make(size_t n, uninitialized_t){
+            return sparse_tensor::map_compression<T>(n);
+        }
+
+        static auto make(size_t n, value_initialized_t){
+            return sparse_tensor::map_compression<T>(n);
+        }
+
+        /** @brief Unstored elements read as T{}, so a fill value cannot be honoured */
+        template< typename V >
+        static auto make(size_t, V const&){
+            static_assert( sizeof(V) == 0, "sparse storage cannot be filled with a value; construct it empty and set() the elements" );
+            return sparse_tensor::map_compression<T>();
+        }
+    };
+
 }
 
 #endif // STORAGE_POLICY_H
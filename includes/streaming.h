@@ -0,0 +1,332 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include "mdspan.h"
+#include "instrumentation.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace streaming::detail{
+
+    struct file_closer{
+        void operator()(std::FILE* f) const noexcept{ if(f) std::fclose(f); }
+    };
+
+    using file_ptr = std::unique_ptr<std::FILE, file_closer>;
+
+    inline file_ptr open(std::string const& path, char const* mode){
+        auto f = file_ptr( std::fopen(path.c_str(), mode) );
+        if( !f ){
+            throw std::runtime_error("Error in streaming::open() : cannot open " + path);
+        }
+        return f;
+    }
+
+    /** @brief True if both paths name the same existing file, also through links or relative paths */
+    inline bool same_file(std::string const& a, std::string const& b) noexcept{
+        auto ec = std::error_code{};
+        return std::filesystem::equivalent(a, b, ec) && !ec;
+    }
+
+    /** @brief Single background thread running submitted I/O tasks in submission order */
+    struct io_thread{
+        io_thread()
+            : _worker([this]{ run(); }){}
+
+        ~io_thread(){
+            {
+                std::lock_guard<std::mutex> l(_m);
+                _stop = true;
+            }
+            _cv.notify_one();
+            _worker.join();
+        }
+
+        io_thread(io_thread const&) = delete;
+        io_thread& operator=(io_thread const&) = delete;
+
+        std::future<void> submit(std::function<void()> f){
+            auto task = std::packaged_task<void()>(std::move(f));
+            auto fut = task.get_future();
+            {
+                std::lock_guard<std::mutex> l(_m);
+                _q.push_back(std::move(task));
+            }
+            _cv.notify_one();
+            return fut;
+        }
+
+    private:
+        void run(){
+            for(;;){
+                auto task = std::packaged_task<void()>{};
+                {
+                    std::unique_lock<std::mutex> l(_m);
+                    _cv.wait(l, [this]{ return _stop || !_q.empty(); });
+                    if( _q.empty() ){
+                        return;
+                    }
+                    task = std::move(_q.front());
+                    _q.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::mutex _m;
+        std::condition_variable _cv;
+        std::deque<std::packaged_task<void()>> _q;
+        bool _stop{false};
+        std::thread _worker;
+    };
+
+}
+
+namespace streaming{
+
+    /** @brief Tensor stored as raw elements in a file, last index fastest
+     *
+     * @code auto f = file_tensor<float>( "a.bin", extents<dynamic_dims>{100000,512,512} );
+     *
+     * @tparam T element type, must be trivially copyable
+     * @tparam E extents type
+     */
+    template< typename T, typename E = mdspan::extents<mdspan::dynamic_dims> >
+    struct file_tensor{
+        static_assert(std::is_trivially_copyable_v<T>, "file_tensor elements must be trivially copyable");
+        static_assert(mdspan::is_extent<E>::value,"NOT A EXTENT TYPE");
+
+        using value_type = T;
+        using extents_type = E;
+
+        file_tensor(std::string path, E e)
+            : _path(std::move(path)), _extent(std::move(e)){}
+
+        std::string const& path() const noexcept{ return _path; }
+        E const& extents() const noexcept{ return _extent; }
+
+        size_t size() const noexcept{
+            return static_cast<size_t>( _extent.product() );
+        }
+
+        /** @brief Number of elements in one slice of the outermost mode */
+        size_t slice_size() const noexcept{
+            return _extent.rank() == 0 ? size_t{0} : size() / static_cast<size_t>( _extent.extent(0) );
+        }
+
+    private:
+        std::string _path;
+        E _extent;
+    };
+
+    /** @brief Chunking of a file_tensor into whole slices of its outermost mode
+     *
+     * A chunk holds as many outermost slices as fit into max_bytes (at least one), so the
+     * resident memory of a pass is bounded by two input and two output chunks.
+     */
+    struct chunking{
+        size_t slice;
+        size_t slices_per_chunk;
+        size_t slices;
+
+        template< typename T, typename E >
+        chunking(file_tensor<T,E> const& f, size_t max_bytes)
+            : chunking( f.size(), f.slice_size(), sizeof(T), max_bytes ){}
+
+        /** @param size number of elements @param slice elements per outermost slice */
+        chunking(size_t size, size_t slice, size_t element_bytes, size_t max_bytes)
+            : slice( slice ),
+              slices_per_chunk( std::max<size_t>( 1, max_bytes / std::max<size_t>( 1, slice * element_bytes ) ) ),
+              slices( slice == 0 ? 0 : size / slice ){}
+
+        size_t chunks() const noexcept{
+            return ( slices + slices_per_chunk - 1 ) / slices_per_chunk;
+        }
+
+        /** @brief Number of elements in chunk c */
+        size_t elements(size_t c) const noexcept{
+            return std::min( slices_per_chunk, slices - c * slices_per_chunk ) * slice;
+        }
+    };
+
+    constexpr size_t default_chunk_bytes = size_t{64} << 20;
+
+    namespace detail{
+
+        template< typename T >
+        void read(std::FILE* f, T* p, size_t n){
+            if( std::fread(p, sizeof(T), n, f) != n ){
+                throw std::runtime_error("Error in streaming::read() : short read");
+            }
+        }
+
+        template< typename T >
+        void write(std::FILE* f, T const* p, size_t n){
+            if( std::fwrite(p, sizeof(T), n, f) != n ){
+                throw std::runtime_error("Error in streaming::write() : short write");
+            }
+        }
+
+        /** @brief Calls body(chunk, in, n) for every chunk while the next chunk is read in the background */
+        template< typename T, typename E, typename Body >
+        void for_each_chunk(file_tensor<T,E> const& in, size_t max_bytes, io_thread& io, Body&& body){
+            auto const c = chunking(in, max_bytes);
+            auto const n = c.chunks();
+            if( n == 0 ){
+                return;
+            }
+
+            auto file = open(in.path(), "rb");
+            std::unique_ptr<T[]> buf[2] = {
+                std::unique_ptr<T[]>( new T[c.elements(0)] ),
+                std::unique_ptr<T[]>( new T[c.elements(0)] )
+            };
+            std::future<void> pending[2];
+
+            auto read_chunk = [&](size_t k){
+                auto* p = buf[k % 2].get();
+                auto const m = c.elements(k);
+                pending[k % 2] = io.submit([f = file.get(), p, m]{ read(f, p, m); });
+            };
+
+            read_chunk(0);
+            try{
+                for(auto k = size_t{0}; k < n; k++){
+                    pending[k % 2].get();
+                    if( k + 1 < n ){
+                        read_chunk(k + 1);
+                    }
+                    body( k, buf[k % 2].get(), c.elements(k) );
+                }
+            }catch(...){
+                // a read may still target buf or file
+                for(auto& p : pending){
+                    if( p.valid() ){
+                        p.wait();
+                    }
+                }
+                throw;
+            }
+        }
+
+    }
+
+    /** @brief Folds op over all elements of a file_tensor in chunks of outermost slices
+     *
+     * @code auto sum = stream_reduce( f, 0.0, [](double a, float x){ return a + x; } );
+     *
+     * @param in tensor to read
+     * @param init initial accumulator
+     * @param op binary operation op(accumulator, element)
+     * @param max_bytes upper bound of one chunk in bytes
+     */
+    template< typename T, typename E, typename R, typename Op >
+    R stream_reduce(file_tensor<T,E> const& in, R init, Op op, size_t max_bytes = default_chunk_bytes){
+        auto timer = instrumentation::scoped_kernel("stream_reduce", in.size() * sizeof(T));
+        auto io = detail::io_thread{};
+        detail::for_each_chunk(in, max_bytes, io, [&](size_t, T const* p, size_t n){
+            for(auto i = size_t{0}; i < n; i++){
+                init = op(std::move(init), p[i]);
+            }
+        });
+        return init;
+    }
+
+    /** @brief Writes f(x) for every element x of in to out in chunks of outermost slices
+     *
+     * Reads and writes run on one background I/O thread; while chunk k is transformed, chunk k + 1
+     * is being read and chunk k - 1 is being written.
+     *
+     * @code stream_transform( a, b, [](float x){ return x * x; } );
+     *
+     * @note in and out must have the same number of elements and be different files; out.path() is overwritten
+     */
+    template< typename T, typename E, typename U, typename EO, typename F >
+    void stream_transform(file_tensor<T,E> const& in, file_tensor<U,EO> const& out, F f, size_t max_bytes = default_chunk_bytes){
+        if( in.size() != out.size() ){
+            throw std::length_error("Error in streaming::stream_transform() : element counts differ");
+        }
+        // opening out truncates it before the first chunk of in is read
+        if( detail::same_file(in.path(), out.path()) ){
+            throw std::invalid_argument("Error in streaming::stream_transform() : input and output are the same file");
+        }
+        auto timer = instrumentation::scoped_kernel("stream_transform", in.size() * ( sizeof(T) + sizeof(U) ));
+        auto const c = chunking(in, max_bytes);
+        auto file = detail::open(out.path(), "wb");
+        std::unique_ptr<U[]> buf[2];
+        std::future<void> written[2];
+
+        {
+            auto io = detail::io_thread{};
+            detail::for_each_chunk(in, max_bytes, io, [&](size_t j, T const* p, size_t n){
+                auto& o = buf[j % 2];
+                if( written[j % 2].valid() ){
+                    written[j % 2].get();
+                }
+                if( !o ){
+                    o.reset( new U[c.elements(0)] );
+                }
+                auto* q = o.get();
+                for(auto i = size_t{0}; i < n; i++){
+                    q[i] = f(p[i]);
+                }
+                written[j % 2] = io.submit([fp = file.get(), q, n]{ detail::write(fp, q, n); });
+            });
+            for(auto& w : written){
+                if( w.valid() ){
+                    w.get();
+                }
+            }
+        }
+    }
+
+    /** @brief Writes a file_tensor whose element at linear index i is gen(i), chunk by chunk */
+    template< typename T, typename E, typename G >
+    void stream_generate(file_tensor<T,E> const& out, G gen, size_t max_bytes = default_chunk_bytes){
+        auto timer = instrumentation::scoped_kernel("stream_generate", out.size() * sizeof(T));
+        auto const c = chunking(out, max_bytes);
+        auto file = detail::open(out.path(), "wb");
+        std::unique_ptr<T[]> buf[2];
+        std::future<void> written[2];
+
+        {
+            // io drains pending writes on destruction, also when gen throws, so it goes before buf
+            auto io = detail::io_thread{};
+            auto offset = size_t{0};
+            for(auto j = size_t{0}; j < c.chunks(); j++){
+                auto& o = buf[j % 2];
+                if( written[j % 2].valid() ){
+                    written[j % 2].get();
+                }
+                if( !o ){
+                    o.reset( new T[c.elements(0)] );
+                }
+                auto* q = o.get();
+                auto const n = c.elements(j);
+                for(auto i = size_t{0}; i < n; i++){
+                    q[i] = gen(offset + i);
+                }
+                offset += n;
+                written[j % 2] = io.submit([fp = file.get(), q, n]{ detail::write(fp, q, n); });
+            }
+            for(auto& w : written){
+                if( w.valid() ){
+                    w.get();
+                }
+            }
+        }
+    }
+
+}
+
+#endif // STREAMING_H
@@ -2,6 +2,23 @@
 #define TENSOR_H
 #include "mdspan.h"
 #include "storage_policy.h"
+#include "layout.h"
+
+namespace test::detail{
+
+    template< typename A, typename = void >
+    struct has_clone : std::false_type{};
+
+    template< typename A >
+    struct has_clone< A, std::void_t< decltype( std::declval<A const&>().clone() ) > > : std::true_type{};
+
+    template< typename A, typename T, typename = void >
+    struct has_set : std::false_type{};
+
+    template< typename A, typename T >
+    struct has_set< A, T, std::void_t< decltype( std::declval<A&>().set( std::declval<T>(), size_t{} ) ) > > : std::true_type{};
+
+}
 
 namespace test{
     using namespace mdspan;
@@ -15,15 +32,127 @@ namespace test{
     template<typename T,typename E = dims<dynamic_dims>,typename F = int, typename A = std::vector<T> >
     struct tensor{
         static_assert(is_extent<E>::value,"NOT A EXTENT TYPE");
-        T at(int) const{
-            return _base.at(0);
+
+        using value_type = T;
+        using extents_type = E;
+        using array_type = A;
+
+        T at(size_t k) const{
+            return _base.at(k);
         }
-        T& at(int){
-            return _base.at(0);
+        decltype(auto) at(size_t k){
+            return _base.at(k);
+        }
+        void set(T val, size_t k){
+            if constexpr( detail::has_set<A,T>::value ){
+                _base.set(std::move(val),k);
+            }else{
+                _base[k] = std::move(val);
+            }
         }
-        void set(T val, size_t k){ _base.insert(val,k);}
         
         tensor() = default;
+
+        /** @brief Constructs a tensor of shape e with value-initialized elements
+         *
+         * @code auto t = tensor<float>( dims<dynamic_dims>{3,4,2} );
+         *
+         * @note allocates once with e.product() elements; passing an rvalue moves e
+         *
+         * @param e shape of the tensor
+         */
+        explicit tensor(E e)
+            : tensor( std::move(e), ::storage_type::value_initialized ){}
+
+        /** @brief Constructs a tensor of shape e without initializing the elements
+         *
+         * @code auto t = tensor<float,dims<dynamic_dims>,int,uninitialized_vector<float>>( e, storage_type::uninitialized );
+         *
+         * @note elements are left indeterminate only if A default-initializes, see storage_type::uninitialized_t
+         */
+        tensor(E e, ::storage_type::uninitialized_t tag)
+            : _extent( std::move(e) ),
+              _base( ::storage_type::storage_traits<A>::make( static_cast<size_t>( _extent.product() ), tag ) ){}
+
+        /** @brief Constructs a tensor of shape e with value-initialized elements */
+        tensor(E e, ::storage_type::value_initialized_t tag)
+            : _extent( std::move(e) ),
+              _base( ::storage_type::storage_traits<A>::make( static_cast<size_t>( _extent.product() ), tag ) ){}
+
+        /** @brief Constructs a tensor of shape e with all elements set to v */
+        tensor(E e, T const& v)
+            : _extent( std::move(e) ),
+              _base( ::storage_type::storage_traits<A>::make( static_cast<size_t>( _extent.product() ), v ) ){}
+
+        /** @brief Constructs a tensor of shape e whose element at linear index k is gen(k)
+         *
+         * @code auto t = tensor<float>( dims<dynamic_dims>{3,4}, [](size_t k){ return float(k); } );
+         *
+         * @note the buffer is written exactly once
+         */
+        template< typename G, 
+            std::enable_if_t< std::is_invocable_r_v<T, G&, size_t> && !std::is_convertible_v<G, T>, int > = 0 >
+        tensor(E e, G&& gen)
+            : _extent( std::move(e) ),
+              _base( ::storage_type::storage_traits<A>::generate( static_cast<size_t>( _extent.product() ), std::forward<G>(gen) ) ){}
+
+        E const& extents() const noexcept{
+            return _extent;
+        }
+
+        size_t size() const noexcept{
+            return static_cast<size_t>( _extent.product() );
+        }
+
+        /** @brief Returns the row-major mapping of the extents, hoist it out of loops
+         *
+         * @code auto m = t.mapping(); for(...) t.data()[ m(i,j,k) ] += 1;
+         *
+         * @note strides that depend on static extents only are compile-time constants, see layout_right
+         */
+        auto mapping() const{
+            return layout_right::mapping<E>(_extent);
+        }
+
+        A const& base() const noexcept{
+            return _base;
+        }
+
+        A& base() noexcept{
+            return _base;
+        }
+
+        auto data() const noexcept{
+            return _base.data();
+        }
+
+        /** @brief Returns this as const, selecting the read-only at() and data()
+         *
+         * @code auto x = t.as_const().at(k);
+         *
+         * @note with storage_type::dense_tensor::shared_dense the non-const at() and data() detach the
+         * buffer and make every later copy deep, reads through as_const() keep it shared
+         */
+        tensor const& as_const() const noexcept{
+            return *this;
+        }
+
+        auto data() noexcept{
+            return _base.data();
+        }
+
+        /** @brief Returns a tensor that owns a deep copy of the data
+         *
+         * Equivalent to a copy for owning storage; for storage_type::dense_tensor::shared_dense
+         * the copy does not share the buffer with this.
+        */
+        tensor clone() const{
+            auto t = *this;
+            if constexpr( detail::has_clone<A>::value ){
+                t._base = _base.clone();
+            }
+            return t;
+        }
     private:
         E _extent;
         A _base;
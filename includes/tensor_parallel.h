@@ -0,0 +1,89 @@
+#ifndef TENSOR_PARALLEL_H
+#define TENSOR_PARALLEL_H
+
+#include "tensor.h"
+#include "numa.h"
+#include "instrumentation.h"
+#include <cassert>
+#include <vector>
+
+namespace test{
+
+    /** @brief Element-wise kernels over dense tensors, parallel over numa::parallel_for
+     *
+     * Every kernel splits the linear range [0, size()) into the same static parts as the
+     * initialization of numa::first_touch_vector storage, with part t pinned to the same CPU, so
+     * each thread streams memory of its own node. Other storage works too, without the placement.
+     */
+
+    /** @brief Sets every element of a to v */
+    template< typename T, typename E, typename F, typename A >
+    void parallel_fill(tensor<T,E,F,A>& a, T const& v, size_t threads = parallel::concurrency()){
+        auto timer = instrumentation::scoped_kernel("parallel_fill", a.size() * sizeof(T));
+        auto* p = a.data();
+        numa::parallel_for(a.size(), [&](size_t b, size_t e, size_t){
+            std::fill(p + b, p + e, v);
+        }, threads);
+    }
+
+    /** @brief out[k] = f(a[k]) for every linear index k */
+    template< typename T, typename EA, typename FA, typename AA, typename U, typename EO, typename FO, typename AO, typename Op >
+    void parallel_transform(tensor<T,EA,FA,AA> const& a, tensor<U,EO,FO,AO>& out, Op f, size_t threads = parallel::concurrency()){
+        assert( a.size() == out.size() );
+        auto timer = instrumentation::scoped_kernel("parallel_transform", a.size() * ( sizeof(T) + sizeof(U) ));
+        auto const* p = a.data();
+        auto* q = out.data();
+        numa::parallel_for(a.size(), [&](size_t b, size_t e, size_t){
+            for(auto k = b; k < e; k++){
+                q[k] = f(p[k]);
+            }
+        }, threads);
+    }
+
+    /** @brief out[k] = f(a[k], c[k]) for every linear index k */
+    template< typename T, typename EA, typename FA, typename AA, typename S, typename EC, typename FC, typename AC,
+              typename U, typename EO, typename FO, typename AO, typename Op >
+    void parallel_transform(tensor<T,EA,FA,AA> const& a, tensor<S,EC,FC,AC> const& c, tensor<U,EO,FO,AO>& out, Op f,
+                            size_t threads = parallel::concurrency())
+    {
+        assert( a.size() == c.size() && a.size() == out.size() );
+        auto timer = instrumentation::scoped_kernel("parallel_transform", a.size() * ( sizeof(T) + sizeof(S) + sizeof(U) ));
+        auto const* p = a.data();
+        auto const* r = c.data();
+        auto* q = out.data();
+        numa::parallel_for(a.size(), [&](size_t b, size_t e, size_t){
+            for(auto k = b; k < e; k++){
+                q[k] = f(p[k], r[k]);
+            }
+        }, threads);
+    }
+
+    /** @brief Reduces every element of a: op(...op(op(init, partial_0), partial_1)..., partial_{p-1})
+     *
+     * Each part folds its range starting from init, then the partials are folded in part order,
+     * so op must be associative and init its identity; the result is deterministic for a fixed
+     * thread count.
+     */
+    template< typename T, typename E, typename F, typename A, typename R, typename Op >
+    R parallel_reduce(tensor<T,E,F,A> const& a, R init, Op op, size_t threads = parallel::concurrency()){
+        auto timer = instrumentation::scoped_kernel("parallel_reduce", a.size() * sizeof(T));
+        threads = std::max<size_t>( 1, std::min(threads, a.size()) );
+        auto partial = std::vector<R>(threads, init);
+        auto const* p = a.data();
+        numa::parallel_for(a.size(), [&](size_t b, size_t e, size_t t){
+            auto acc = init;
+            for(auto k = b; k < e; k++){
+                acc = op(acc, p[k]);
+            }
+            partial[t] = acc;
+        }, threads);
+        auto r = init;
+        for(auto const& x : partial){
+            r = op(r, x);
+        }
+        return r;
+    }
+
+}
+
+#endif // TENSOR_PARALLEL_H
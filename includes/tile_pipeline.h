@@ -0,0 +1,530 @@
+#ifndef TILE_PIPELINE_H
+#define TILE_PIPELINE_H
+
+#include "streaming.h"
+#include "parallel.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace streaming::detail{
+
+    /** @brief Lazily evaluated sequence of values produced by a coroutine with co_yield */
+    template< typename T >
+    struct generator{
+        struct promise_type{
+            T const* value{nullptr};
+            std::exception_ptr error;
+
+            generator get_return_object() noexcept{
+                return generator( std::coroutine_handle<promise_type>::from_promise(*this) );
+            }
+            std::suspend_always initial_suspend() noexcept{ return {}; }
+            std::suspend_always final_suspend() noexcept{ return {}; }
+            std::suspend_always yield_value(T const& v) noexcept{
+                value = std::addressof(v);
+                return {};
+            }
+            void return_void() noexcept{}
+            void unhandled_exception() noexcept{ error = std::current_exception(); }
+        };
+
+        struct sentinel{};
+
+        struct iterator{
+            std::coroutine_handle<promise_type> h;
+
+            iterator& operator++(){
+                h.resume();
+                rethrow();
+                return *this;
+            }
+            T const& operator*() const noexcept{ return *h.promise().value; }
+            bool operator==(sentinel) const noexcept{ return h.done(); }
+            bool operator!=(sentinel) const noexcept{ return !h.done(); }
+
+            void rethrow() const{
+                if( h.done() && h.promise().error ){
+                    std::rethrow_exception( h.promise().error );
+                }
+            }
+        };
+
+        explicit generator(std::coroutine_handle<promise_type> h) noexcept
+            : _h(h){}
+
+        generator(generator&& other) noexcept
+            : _h( std::exchange(other._h, {}) ){}
+
+        generator(generator const&) = delete;
+        generator& operator=(generator const&) = delete;
+        generator& operator=(generator&&) = delete;
+
+        ~generator(){
+            if( _h ){
+                _h.destroy();
+            }
+        }
+
+        iterator begin(){
+            _h.resume();
+            auto it = iterator{_h};
+            it.rethrow();
+            return it;
+        }
+        sentinel end() const noexcept{ return {}; }
+
+    private:
+        std::coroutine_handle<promise_type> _h;
+    };
+
+    /** @brief Coroutine that starts eagerly and destroys itself when it finishes */
+    struct detached{
+        struct promise_type{
+            detached get_return_object() noexcept{ return {}; }
+            std::suspend_never initial_suspend() noexcept{ return {}; }
+            std::suspend_never final_suspend() noexcept{ return {}; }
+            void return_void() noexcept{}
+            void unhandled_exception() noexcept{ std::terminate(); }
+        };
+    };
+
+    /** @brief Fixed set of worker threads resuming the coroutines that co_await schedule() */
+    struct thread_pool{
+        explicit thread_pool(size_t threads){
+            for(auto t = size_t{0}; t < std::max<size_t>(threads, 1); t++){
+                _workers.emplace_back([this]{ run(); });
+            }
+        }
+
+        ~thread_pool(){
+            {
+                std::lock_guard<std::mutex> l(_m);
+                _stop = true;
+            }
+            _cv.notify_all();
+            for(auto& w : _workers){
+                w.join();
+            }
+        }
+
+        thread_pool(thread_pool const&) = delete;
+        thread_pool& operator=(thread_pool const&) = delete;
+
+        /** @brief Awaitable that continues the awaiting coroutine on a worker */
+        auto schedule() noexcept{
+            struct awaiter{
+                thread_pool* pool;
+                bool await_ready() const noexcept{ return false; }
+                void await_suspend(std::coroutine_handle<> h){ pool->post(h); }
+                void await_resume() const noexcept{}
+            };
+            return awaiter{this};
+        }
+
+    private:
+        void post(std::coroutine_handle<> h){
+            {
+                std::lock_guard<std::mutex> l(_m);
+                _q.push_back(h);
+            }
+            _cv.notify_one();
+        }
+
+        void run(){
+            for(;;){
+                auto h = std::coroutine_handle<>{};
+                {
+                    std::unique_lock<std::mutex> l(_m);
+                    _cv.wait(l, [this]{ return _stop || !_q.empty(); });
+                    if( _q.empty() ){
+                        return;
+                    }
+                    h = _q.front();
+                    _q.pop_front();
+                }
+                h.resume();
+            }
+        }
+
+        std::mutex _m;
+        std::condition_variable _cv;
+        std::deque<std::coroutine_handle<>> _q;
+        bool _stop{false};
+        std::vector<std::thread> _workers;
+    };
+
+    /** @brief Awaitable that continues the awaiting coroutine on the I/O thread */
+    inline auto resume_on(io_thread& io) noexcept{
+        struct awaiter{
+            io_thread* io;
+            bool await_ready() const noexcept{ return false; }
+            void await_suspend(std::coroutine_handle<> h){ io->submit([h]{ h.resume(); }); }
+            void await_resume() const noexcept{}
+        };
+        return awaiter{&io};
+    }
+
+    /** @brief Bounded set of tile slots; acquire() blocks while all of them are in flight */
+    struct slot_pool{
+        explicit slot_pool(size_t n){
+            for(auto i = n; i-- > 0u;){
+                _free.push_back(i);
+            }
+            _size = n;
+        }
+
+        size_t acquire(){
+            std::unique_lock<std::mutex> l(_m);
+            _cv.wait(l, [this]{ return !_free.empty(); });
+            auto const i = _free.back();
+            _free.pop_back();
+            return i;
+        }
+
+        void release(size_t i){
+            // notified under the lock: the pool may be destroyed as soon as wait_idle() sees it
+            std::lock_guard<std::mutex> l(_m);
+            _free.push_back(i);
+            _cv.notify_all();
+        }
+
+        /** @brief Blocks until every slot is released */
+        void wait_idle(){
+            std::unique_lock<std::mutex> l(_m);
+            _cv.wait(l, [this]{ return _free.size() == _size; });
+        }
+
+    private:
+        std::mutex _m;
+        std::condition_variable _cv;
+        std::vector<size_t> _free;
+        size_t _size{0};
+    };
+
+}
+
+namespace streaming{
+
+    /** @brief Consecutive outermost slices of a tensor: count elements from linear index offset */
+    template< typename T >
+    struct tile{
+        size_t index;
+        size_t offset;
+        size_t count;
+        T* data;
+        size_t slot;
+    };
+
+    struct pipeline_options{
+        size_t tile_bytes = size_t{4} << 20;        // upper bound of one input tile, rounded to whole slices
+        size_t threads = parallel::concurrency();   // compute threads
+        size_t in_flight = 0;                       // tiles resident at once, 0 for threads + 2
+    };
+
+    /** @brief Read-only memory mapping of a file_tensor
+     *
+     * @code auto m = mapped_tensor<float>( f ); tile_transform( m.data(), f.extents(), out, k );
+     */
+    template< typename T >
+    struct mapped_tensor{
+        template< typename E >
+        explicit mapped_tensor(file_tensor<T,E> const& f)
+            : _n( f.size() )
+        {
+#if defined(__linux__)
+            if( _n == 0 ){
+                return;
+            }
+            auto const fd = ::open(f.path().c_str(), O_RDONLY);
+            if( fd < 0 ){
+                throw std::runtime_error("Error in streaming::mapped_tensor() : cannot open " + f.path());
+            }
+            struct stat st{};
+            if( ::fstat(fd, &st) != 0 || size_t(st.st_size) < _n * sizeof(T) ){
+                ::close(fd);
+                throw std::runtime_error("Error in streaming::mapped_tensor() : file too short " + f.path());
+            }
+            auto* p = ::mmap(nullptr, _n * sizeof(T), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if( p == MAP_FAILED ){
+                throw std::runtime_error("Error in streaming::mapped_tensor() : cannot map " + f.path());
+            }
+            ::madvise(p, _n * sizeof(T), MADV_SEQUENTIAL);
+            _p = static_cast<T const*>(p);
+#else
+            throw std::runtime_error("Error in streaming::mapped_tensor() : memory mapping not supported");
+#endif
+        }
+
+        ~mapped_tensor(){
+#if defined(__linux__)
+            if( _p ){
+                ::munmap( const_cast<T*>(_p), _n * sizeof(T) );
+            }
+#endif
+        }
+
+        mapped_tensor(mapped_tensor const&) = delete;
+        mapped_tensor& operator=(mapped_tensor const&) = delete;
+
+        T const* data() const noexcept{ return _p; }
+        size_t size() const noexcept{ return _n; }
+
+    private:
+        T const* _p{nullptr};
+        size_t _n;
+    };
+
+}
+
+namespace streaming::detail{
+
+    /** @brief Tiles of memory-resident input, pointing into it */
+    template< typename T >
+    generator< tile<T const> > memory_tiles(T const* p, chunking c, slot_pool& slots){
+        auto offset = size_t{0};
+        for(auto k = size_t{0}; k < c.chunks(); k++){
+            auto const slot = slots.acquire();
+            auto const n = c.elements(k);
+            co_yield tile<T const>{ k, offset, n, p + offset, slot };
+            offset += n;
+        }
+    }
+
+    /** @brief Tiles of a file_tensor, each read into the buffer of its slot */
+    template< typename T, typename E >
+    generator< tile<T const> > file_tiles(file_tensor<T,E> const& in, chunking c, slot_pool& slots, T* buffers){
+        auto file = open(in.path(), "rb");
+        auto const capacity = c.slices_per_chunk * c.slice;
+        auto offset = size_t{0};
+        for(auto k = size_t{0}; k < c.chunks(); k++){
+            auto const slot = slots.acquire();
+            auto const n = c.elements(k);
+            auto* p = buffers + slot * capacity;
+            try{
+                read(file.get(), p, n);
+            }catch(...){
+                slots.release(slot);
+                throw;
+            }
+            co_yield tile<T const>{ k, offset, n, p, slot };
+            offset += n;
+        }
+    }
+
+    /** @brief Shared state of one pipeline run; the first exception of any stage wins
+     *
+     * The pool and the I/O thread are declared last, so they are joined before anything a
+     * coroutine touches is destroyed.
+     */
+    struct pipeline_state{
+        slot_pool slots;
+        std::mutex m;
+        std::exception_ptr error;
+        std::atomic<bool> failed{false};
+        io_thread io;
+        thread_pool pool;
+
+        pipeline_state(size_t threads, size_t in_flight)
+            : slots(in_flight), pool(threads){}
+
+        template< typename F >
+        void guard(F&& f) noexcept{
+            if( failed.load(std::memory_order_relaxed) ){
+                return;
+            }
+            try{
+                f();
+            }catch(...){
+                std::lock_guard<std::mutex> l(m);
+                if( !error ){
+                    error = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    /** @brief Moves f to byte offset from the start, past the range of long on LLP64 and 32-bit targets
+     *
+     * @note 32-bit POSIX targets need _FILE_OFFSET_BITS=64 for a 64-bit off_t
+     */
+    inline void seek(std::FILE* f, size_t offset){
+#if defined(_WIN32)
+        using offset_type = __int64;
+#else
+        using offset_type = off_t;
+#endif
+        if( offset > static_cast<size_t>( std::numeric_limits<offset_type>::max() ) ){
+            throw std::runtime_error("Error in streaming::seek() : offset exceeds the file offset type");
+        }
+#if defined(_WIN32)
+        auto const r = ::_fseeki64(f, static_cast<offset_type>(offset), SEEK_SET);
+#else
+        auto const r = ::fseeko(f, static_cast<offset_type>(offset), SEEK_SET);
+#endif
+        if( r != 0 ){
+            throw std::runtime_error("Error in streaming::seek() : seek failed");
+        }
+    }
+
+    /** @brief Compute stage on the pool, then the store stage on the I/O thread if out is a file buffer */
+    template< typename T, typename U, typename K >
+    detached process_tile(pipeline_state& s, tile<T const> t, U* out, std::FILE* file, K& kernel){
+        co_await s.pool.schedule();
+        s.guard([&]{ kernel(t.data, out, t.count, t.offset); });
+        if( file ){
+            co_await resume_on(s.io);
+            s.guard([&]{
+                seek(file, t.offset * sizeof(U));
+                write(file, static_cast<U const*>(out), t.count);
+            });
+        }
+        s.slots.release(t.slot);
+    }
+
+    /** @brief Runs the tiles of make_source(slots, in_flight) through kernel into out, or into out_path if given */
+    template< typename T, typename U, typename Source, typename K >
+    void run_pipeline(chunking const& c, pipeline_options const& o, Source&& make_source,
+                      U* out, std::string const* out_path, K& kernel)
+    {
+        auto const threads = std::max<size_t>(1, o.threads);
+        auto const in_flight = o.in_flight == 0 ? threads + 2u : o.in_flight;
+        auto const capacity = c.slices_per_chunk * c.slice;
+
+        auto file = file_ptr{};
+        auto buffers = std::unique_ptr<U[]>{};
+        if( out_path ){
+            file = open(*out_path, "wb");
+            buffers.reset( new U[ capacity * in_flight ] );
+        }
+        if( c.chunks() == 0 ){
+            return;
+        }
+
+        auto s = pipeline_state(threads, in_flight);
+        try{
+            for(auto const& t : make_source(s.slots, in_flight)){
+                auto* o = file ? buffers.get() + t.slot * capacity : out + t.offset;
+                process_tile(s, t, o, file.get(), kernel);
+                if( s.failed.load(std::memory_order_relaxed) ){
+                    break;
+                }
+            }
+        }catch(...){
+            s.slots.wait_idle();
+            throw;
+        }
+        s.slots.wait_idle();
+        if( s.error ){
+            std::rethrow_exception(s.error);
+        }
+    }
+
+    template< typename E >
+    chunking tile_chunking(E const& e, size_t size, size_t element_bytes, size_t tile_bytes){
+        auto const slice = e.rank() == 0 || e.extent(0) == 0 ? size : size / static_cast<size_t>( e.extent(0) );
+        return chunking( size, slice, element_bytes, tile_bytes );
+    }
+
+}
+
+namespace streaming{
+
+    /** @brief Streams the tiles of a tensor through a producer -> kernel -> consumer coroutine pipeline
+     *
+     * The index space is cut into tiles of whole outermost slices of at most o.tile_bytes. A
+     * generator produces the tiles, reading them from the file into slot buffers or pointing into
+     * memory (e.g. a mapped_tensor); each tile then runs as a coroutine that hops onto the compute
+     * pool for kernel(in, out, n, offset) and, for file output, onto the I/O thread to write its
+     * result at its offset. At most o.in_flight tiles are resident, so memory stays constant while
+     * the next reads, the kernels and the previous writes overlap; tiles may finish out of order.
+     *
+     * @code tile_transform( a, b, [](float const* in, float* out, size_t n, size_t){ for(...) out[i] = in[i] * in[i]; } );
+     *
+     * @param in file_tensor, or pointer and extents of memory-resident input
+     * @param out file_tensor (overwritten) or pointer to size() elements, e.g. test::tensor::data()
+     * @param kernel kernel(T const* in, U* out, size_t n, size_t offset), called concurrently
+     *
+     * @note requires C++20 coroutines
+     * @note an output file must not be the input file, nor the file behind a mapped_tensor passed as in
+     */
+    template< typename T, typename E, typename U, typename EO, typename K >
+    void tile_transform(file_tensor<T,E> const& in, file_tensor<U,EO> const& out, K kernel, pipeline_options const& o = {}){
+        if( in.size() != out.size() ){
+            throw std::length_error("Error in streaming::tile_transform() : element counts differ");
+        }
+        // opening out truncates it before the first tile of in is read
+        if( detail::same_file(in.path(), out.path()) ){
+            throw std::invalid_argument("Error in streaming::tile_transform() : input and output are the same file");
+        }
+        auto timer = instrumentation::scoped_kernel("tile_transform", in.size() * ( sizeof(T) + sizeof(U) ));
+        auto const c = chunking(in, o.tile_bytes);
+        auto buffers = std::unique_ptr<T[]>{};
+        detail::run_pipeline<T, U>(c, o, [&](detail::slot_pool& slots, size_t in_flight){
+            buffers.reset( new T[ c.slices_per_chunk * c.slice * in_flight ] );
+            return detail::file_tiles(in, c, slots, buffers.get());
+        }, static_cast<U*>(nullptr), &out.path(), kernel);
+    }
+
+    template< typename T, typename E, typename U, typename K >
+    void tile_transform(file_tensor<T,E> const& in, U* out, K kernel, pipeline_options const& o = {}){
+        auto timer = instrumentation::scoped_kernel("tile_transform", in.size() * ( sizeof(T) + sizeof(U) ));
+        auto const c = chunking(in, o.tile_bytes);
+        auto buffers = std::unique_ptr<T[]>{};
+        detail::run_pipeline<T, U>(c, o, [&](detail::slot_pool& slots, size_t in_flight){
+            buffers.reset( new T[ c.slices_per_chunk * c.slice * in_flight ] );
+            return detail::file_tiles(in, c, slots, buffers.get());
+        }, out, nullptr, kernel);
+    }
+
+    template< typename T, typename E, typename U, typename EO, typename K >
+    void tile_transform(T const* in, E const& e, file_tensor<U,EO> const& out, K kernel, pipeline_options const& o = {}){
+        auto const n = static_cast<size_t>( e.product() );
+        if( n != out.size() ){
+            throw std::length_error("Error in streaming::tile_transform() : element counts differ");
+        }
+        auto timer = instrumentation::scoped_kernel("tile_transform", n * ( sizeof(T) + sizeof(U) ));
+        auto const c = detail::tile_chunking(e, n, sizeof(T), o.tile_bytes);
+        detail::run_pipeline<T, U>(c, o, [&](detail::slot_pool& slots, size_t){
+            return detail::memory_tiles(in, c, slots);
+        }, static_cast<U*>(nullptr), &out.path(), kernel);
+    }
+
+    template< typename T, typename E, typename U, typename K >
+    void tile_transform(T const* in, E const& e, U* out, K kernel, pipeline_options const& o = {}){
+        auto const n = static_cast<size_t>( e.product() );
+        auto timer = instrumentation::scoped_kernel("tile_transform", n * ( sizeof(T) + sizeof(U) ));
+        auto const c = detail::tile_chunking(e, n, sizeof(T), o.tile_bytes);
+        detail::run_pipeline<T, U>(c, o, [&](detail::slot_pool& slots, size_t){
+            return detail::memory_tiles(in, c, slots);
+        }, out, nullptr, kernel);
+    }
+
+}
+
+#else
+
+#error "tile_pipeline.h requires C++20 coroutines"
+
+#endif // __cpp_impl_coroutine
+
+#endif // TILE_PIPELINE_H
@@ -0,0 +1,211 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include "tensor.h"
+#include "parallel.h"
+#include "instrumentation.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace test{
+
+    /** @brief The k best elements of every fiber along one mode, best first, and their positions in the fiber */
+    template< typename T >
+    struct topk_result{
+        tensor<T, dims<dynamic_dims>> values;
+        tensor<size_t, dims<dynamic_dims>> indices;
+    };
+
+}
+
+namespace test::detail{
+
+    /** @brief Fibers gathered into contiguous scratch per work unit of topk() when partially sorting */
+    constexpr size_t topk_tile = 16;
+
+    /** @brief Fibers per work unit of topk() when streaming rows through per-fiber heaps */
+    constexpr size_t topk_row_tile = 1024;
+
+    /** @brief Writes the k best elements of the contiguous fiber f[0, n) to v[j * s], i[j * s], best first
+     *
+     * For k small against n a k-element heap with the worst kept on top filters the fiber in one
+     * pass, and after the first k elements most of them are rejected by a single comparison with the
+     * top; otherwise positions are partially sorted. Equal elements keep increasing position, so
+     * the result is deterministic.
+     */
+    template< typename T, typename Compare >
+    void topk_fiber(T const* f, size_t n, size_t k, Compare& comp, std::vector<std::pair<T,size_t>>& heap,
+                    T* v, size_t* idx, ptrdiff_t s)
+    {
+        auto better = [&](std::pair<T,size_t> const& p, std::pair<T,size_t> const& q){
+            return comp(p.first, q.first) || ( !comp(q.first, p.first) && p.second < q.second );
+        };
+
+        heap.clear();
+        if( k * 8u >= n ){
+            for(auto i = size_t{0}; i < n; i++){
+                heap.emplace_back(f[i], i);
+            }
+            std::partial_sort(heap.begin(), heap.begin() + ptrdiff_t(k), heap.end(), better);
+        }else{
+            for(auto i = size_t{0}; i < k; i++){
+                heap.emplace_back(f[i], i);
+            }
+            std::make_heap(heap.begin(), heap.end(), better);
+            for(auto i = k; i < n; i++){
+                // equal to the worst kept element means later in the fiber, i.e. worse
+                if( comp(f[i], heap.front().first) ){
+                    std::pop_heap(heap.begin(), heap.end(), better);
+                    heap.back() = { f[i], i };
+                    std::push_heap(heap.begin(), heap.end(), better);
+                }
+            }
+            std::sort_heap(heap.begin(), heap.end(), better);
+        }
+        for(auto j = size_t{0}; j < k; j++){
+            v[ ptrdiff_t(j) * s ] = heap[j].first;
+            idx[ ptrdiff_t(j) * s ] = heap[j].second;
+        }
+    }
+
+    /** @brief topk_fiber with the heap strategy for the m fibers src[c + i * inner], c in [0, m)
+     *
+     * Rows i are read front to back, each a contiguous run of m elements, and every element is
+     * compared with the worst kept element of its own fiber's heap, so memory is streamed once.
+     */
+    template< typename T, typename Compare >
+    void topk_rows(T const* src, size_t n, size_t inner, size_t m, size_t k, Compare& comp,
+                   std::vector<std::pair<T,size_t>>& heaps, std::vector<T>& worst, T* v, size_t* idx)
+    {
+        auto better = [&](std::pair<T,size_t> const& p, std::pair<T,size_t> const& q){
+            return comp(p.first, q.first) || ( !comp(q.first, p.first) && p.second < q.second );
+        };
+
+        heaps.resize(m * k);
+        worst.resize(m);
+        for(auto i = size_t{0}; i < k; i++){
+            for(auto c = size_t{0}; c < m; c++){
+                heaps[c * k + i] = { src[i * inner + c], i };
+            }
+        }
+        for(auto c = size_t{0}; c < m; c++){
+            auto const h = heaps.begin() + ptrdiff_t(c * k);
+            std::make_heap(h, h + ptrdiff_t(k), better);
+            worst[c] = h->first;
+        }
+        for(auto i = k; i < n; i++){
+            auto const* row = src + i * inner;
+            for(auto c = size_t{0}; c < m; c++){
+                if( comp(row[c], worst[c]) ){
+                    auto const h = heaps.begin() + ptrdiff_t(c * k);
+                    std::pop_heap(h, h + ptrdiff_t(k), better);
+                    h[ptrdiff_t(k) - 1] = { row[c], i };
+                    std::push_heap(h, h + ptrdiff_t(k), better);
+                    worst[c] = h->first;
+                }
+            }
+        }
+        for(auto c = size_t{0}; c < m; c++){
+            auto const h = heaps.begin() + ptrdiff_t(c * k);
+            std::sort_heap(h, h + ptrdiff_t(k), better);
+            for(auto j = size_t{0}; j < k; j++){
+                v[j * inner + c] = h[ptrdiff_t(j)].first;
+                idx[j * inner + c] = h[ptrdiff_t(j)].second;
+            }
+        }
+    }
+
+}
+
+namespace test{
+
+    /** @brief Selects the k best elements of every fiber along mode
+     *
+     * The result has the extents of a with extent k at mode, holding for every fiber its k best
+     * elements best first and their indices along mode; "best" is the first in the order comp, so
+     * the default std::greater<> gives the k largest. With L and R the products of the extents
+     * before and after mode, fiber (l, r) starts at l * n * R + r with stride R. Work units of
+     * parallel::parallel_for are groups of neighbouring fibers. Contiguous fibers (R == 1) are
+     * selected in place. Strided fibers with k small against n are streamed row by row through one
+     * heap per fiber; otherwise up to 16 of them are copied into per-thread scratch and partially
+     * sorted there.
+     *
+     * @code auto best = topk( scores, 1, 10 ); // scores: {users, items} -> {users, 10}
+     *
+     * @param a dense tensor with row-major layout
+     * @param mode mode to select along
+     * @param k number of elements kept per fiber, from 1 to the extent of mode
+     * @param comp strict weak order, comp(x, y) if x is better than y; called concurrently
+     */
+    template< typename T, typename E, typename F, typename A, typename Compare = std::greater<> >
+    topk_result<T> topk(tensor<T,E,F,A> const& a, size_t mode, size_t k, Compare comp = {},
+                        size_t threads = parallel::concurrency())
+    {
+        auto const e = to_dynamic(a.extents());
+        if( mode >= e.rank() ){
+            throw std::length_error("Error in topk() : mode exceeds rank");
+        }
+        auto const n = static_cast<size_t>( e[mode] );
+        if( k == 0u || k > n ){
+            throw std::length_error("Error in topk() : k must be in [1, extent of mode]");
+        }
+
+        auto eo = e.base();
+        eo[mode] = static_cast<ptrdiff_t>(k);
+        auto r = topk_result<T>{
+            tensor<T, dims<dynamic_dims>>( dims<dynamic_dims>(eo), storage_type::uninitialized ),
+            tensor<size_t, dims<dynamic_dims>>( dims<dynamic_dims>(eo), storage_type::uninitialized )
+        };
+        auto timer = instrumentation::scoped_kernel("topk", a.size() * sizeof(T) + r.values.size() * ( sizeof(T) + sizeof(size_t) ));
+
+        auto outer = size_t{1}, inner = size_t{1};
+        for(auto q = size_t{0}; q < e.rank(); q++){
+            if( q < mode ) outer *= static_cast<size_t>( e[q] );
+            if( q > mode ) inner *= static_cast<size_t>( e[q] );
+        }
+        auto const streaming = inner > 1u && k * 8u < n;
+        auto const tile = std::min(inner, streaming ? detail::topk_row_tile : detail::topk_tile);
+        auto const tiles = ( inner + tile - 1u ) / tile;
+
+        auto const* p = a.data();
+        auto* v = r.values.data();
+        auto* idx = r.indices.data();
+        parallel::parallel_for(outer * tiles, [&](size_t b, size_t end, size_t){
+            auto heap = std::vector<std::pair<T,size_t>>{};
+            auto worst = std::vector<T>{};
+            auto scratch = std::vector<T>( inner == 1u || streaming ? 0u : tile * n );
+            for(auto u = b; u < end; u++){
+                auto const l = u / tiles;
+                auto const r0 = ( u % tiles ) * tile;
+                auto const m = std::min(tile, inner - r0);
+                auto const* src = p + l * n * inner + r0;
+                auto* vo = v + l * k * inner + r0;
+                auto* io = idx + l * k * inner + r0;
+
+                if( inner == 1u ){
+                    detail::topk_fiber(src, n, k, comp, heap, vo, io, 1);
+                    continue;
+                }
+                if( streaming ){
+                    detail::topk_rows(src, n, inner, m, k, comp, heap, worst, vo, io);
+                    continue;
+                }
+                for(auto i = size_t{0}; i < n; i++){
+                    for(auto c = size_t{0}; c < m; c++){
+                        scratch[c * n + i] = src[i * inner + c];
+                    }
+                }
+                for(auto c = size_t{0}; c < m; c++){
+                    detail::topk_fiber(scratch.data() + c * n, n, k, comp, heap, vo + c, io + c, ptrdiff_t(inner));
+                }
+            }
+        }, threads);
+        return r;
+    }
+
+}
+
+#endif // TOPK_H
@@ -0,0 +1,204 @@
+#ifndef UNFOLD_H
+#define UNFOLD_H
+
+#include "tensor.h"
+#include "gemm.h"
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+
+namespace test{
+
+    /** @brief Strided matrix view: element (i,j) is data[i * rs + j * cs] */
+    template< typename T >
+    struct matrix_view{
+        T* data;
+        size_t rows;
+        size_t cols;
+        ptrdiff_t rs;
+        ptrdiff_t cs;
+
+        T& operator()(size_t i, size_t j) const noexcept{
+            return data[ ptrdiff_t(i) * rs + ptrdiff_t(j) * cs ];
+        }
+    };
+
+    /** @brief Mode-k unfolding of a row-major tensor as a matrix, without copying
+     *
+     * Row i is index i of mode k and column j enumerates the remaining modes in order, last fastest,
+     * so the column extents are remove_extent_item(e, k). With L the product of the extents before
+     * mode k and R the product of those after it, column j = a * R + b maps element (i,j) to
+     * data[ a * n_k * R + i * R + b ]: no single column stride exists unless L or R is 1, but the
+     * unfolding is a row of strided panels, either L panels of n_k x R (rs R, cs 1; contiguous rows)
+     * or R panels of n_k x L (rs R, cs n_k R). panels() picks the smaller count, i.e. the larger
+     * panels, and the kernels below run test::gemm once per panel.
+     *
+     * @code auto x = unfold(t, 1); // t: {I,J,K} -> J x (I*K)
+     *
+     * @tparam T value type, const for a read-only view
+     */
+    template< typename T >
+    struct unfolding{
+        using value_type = std::remove_const_t<T>;
+
+        unfolding(T* data, extents<dynamic_dims> const& e, size_t k)
+            : _data(data), _k(k), _cols( remove_extent_item(e, k) )
+        {
+            assert( k < e.rank() );
+            _rows = e[k];
+            for(auto q = size_t{0}; q < e.rank(); q++){
+                if( q < k ) _outer *= e[q];
+                if( q > k ) _inner *= e[q];
+            }
+        }
+
+        /** @brief Read-only view of the same unfolding */
+        operator unfolding<T const>() const{
+            return unfolding<T const>(_data, *this);
+        }
+
+        size_t mode() const noexcept{ return _k; }
+        size_t rows() const noexcept{ return size_t(_rows); }
+        size_t cols() const noexcept{ return size_t(_outer * _inner); }
+        extents<dynamic_dims> const& col_extents() const noexcept{ return _cols; }
+        T* data() const noexcept{ return _data; }
+
+        T& operator()(size_t i, size_t j) const noexcept{
+            auto const a = ptrdiff_t(j) / _inner, b = ptrdiff_t(j) % _inner;
+            return _data[ ( a * _rows + ptrdiff_t(i) ) * _inner + b ];
+        }
+
+        /** @brief Number of strided panels the columns split into, min(L, R) */
+        size_t panels() const noexcept{
+            return size_t( by_outer() ? _outer : _inner );
+        }
+
+        /** @brief Panel p: the columns col_offset(p) + c * col_stride() for c in [0, panel(p).cols) */
+        matrix_view<T> panel(size_t p) const noexcept{
+            if( by_outer() ){
+                return { _data + ptrdiff_t(p) * _rows * _inner, size_t(_rows), size_t(_inner), _inner, 1 };
+            }
+            return { _data + ptrdiff_t(p), size_t(_rows), size_t(_outer), _inner, _rows * _inner };
+        }
+
+        ptrdiff_t col_offset(size_t p) const noexcept{ return by_outer() ? ptrdiff_t(p) * _inner : ptrdiff_t(p); }
+        ptrdiff_t col_stride() const noexcept{ return by_outer() ? 1 : _inner; }
+
+        /** @brief True if two unfoldings split their columns into the same panels */
+        template< typename U >
+        bool same_columns(unfolding<U> const& other) const noexcept{
+            return _outer == other._outer && _inner == other._inner;
+        }
+
+    private:
+        template< typename U >
+        friend struct unfolding;
+
+        template< typename U >
+        unfolding(T* data, unfolding<U> const& other)
+            : _data(data), _k(other._k), _rows(other._rows), _outer(other._outer), _inner(other._inner), _cols(other._cols){}
+
+        bool by_outer() const noexcept{ return _outer <= _inner; }
+
+        T* _data;
+        size_t _k;
+        ptrdiff_t _rows{1};
+        ptrdiff_t _outer{1};
+        ptrdiff_t _inner{1};
+        extents<dynamic_dims> _cols;
+    };
+
+    /** @brief Mode-k unfolding of a dense tensor, see unfolding */
+    template< typename T, typename E, typename F, typename A >
+    unfolding<T const> unfold(tensor<T,E,F,A> const& t, size_t k){
+        if( k >= static_cast<size_t>( t.extents().rank() ) ){
+            throw std::length_error("Error in unfold() : mode exceeds rank");
+        }
+        return unfolding<T const>( t.data(), to_dynamic(t.extents()), k );
+    }
+
+    template< typename T, typename E, typename F, typename A >
+    unfolding<T> unfold(tensor<T,E,F,A>& t, size_t k){
+        if( k >= static_cast<size_t>( t.extents().rank() ) ){
+            throw std::length_error("Error in unfold() : mode exceeds rank");
+        }
+        return unfolding<T>( t.data(), to_dynamic(t.extents()), k );
+    }
+
+    /** @brief C = alpha * X_(k) * B + beta * C with the unfolding X_(k) as left operand
+     *
+     * B is x.cols() x n and C is x.rows() x n, both strided. Every panel multiplies the rows of B
+     * of its columns, which are again a strided matrix, and accumulates onto C; this is the
+     * product with a Khatri-Rao matrix in CP-ALS.
+     *
+     * @code gemm( r, 1.f, unfold(t, 1), kr.data(), r, 1, 0.f, m.data(), r, 1 );
+     */
+    template< typename T >
+    void gemm(size_t n, T alpha, unfolding< std::add_const_t<T> > const& x, T const* b, ptrdiff_t rsb, ptrdiff_t csb,
+              T beta, T* c, ptrdiff_t rsc, ptrdiff_t csc)
+    {
+        if( x.panels() == 0u ){
+            gemm( x.rows(), n, size_t{0}, alpha, b, rsb, csb, b, rsb, csb, beta, c, rsc, csc );
+            return;
+        }
+        for(auto p = size_t{0}; p < x.panels(); p++){
+            auto const xp = x.panel(p);
+            gemm( xp.rows, n, xp.cols, alpha, xp.data, xp.rs, xp.cs,
+                  b + x.col_offset(p) * rsb, x.col_stride() * rsb, csb,
+                  p == 0 ? beta : T{1}, c, rsc, csc );
+        }
+    }
+
+    /** @brief Y_(k) = alpha * A * X_(k) + beta * Y_(k), the mode-k product written through unfoldings
+     *
+     * A is m x x.rows() and y the mode-k unfolding of a tensor that has extent m in mode k and the
+     * extents of x elsewhere, so both split into the same panels and each panel is one gemm; the
+     * projection step of HOSVD and Tucker-ALS.
+     *
+     * @code gemm( 1.f, u.data(), 1, r, unfold(x, k), 0.f, unfold(y, k) ); // y = x x_k u^T
+     */
+    template< typename T >
+    void gemm(T alpha, T const* a, ptrdiff_t rsa, ptrdiff_t csa, unfolding< std::add_const_t<T> > const& x,
+              T beta, unfolding<T> const& y)
+    {
+        if( !x.same_columns(y) ){
+            throw std::length_error("Error in gemm() : unfoldings have different columns");
+        }
+        for(auto p = size_t{0}; p < x.panels(); p++){
+            auto const xp = x.panel(p);
+            auto const yp = y.panel(p);
+            gemm( yp.rows, xp.cols, xp.rows, alpha, a, rsa, csa, xp.data, xp.rs, xp.cs, beta, yp.data, yp.rs, yp.cs );
+        }
+    }
+
+    /** @brief G = X_(k) X_(k)^T, the rows() x rows() Gram matrix of the unfolding
+     *
+     * Summed over the panels, each multiplied by its own transpose through swapped strides.
+     */
+    template< typename U >
+    void gram(unfolding<U> const& x, std::remove_const_t<U>* g, ptrdiff_t rsg, ptrdiff_t csg){
+        using T = std::remove_const_t<U>;
+        if( x.panels() == 0u ){
+            gemm( x.rows(), x.rows(), size_t{0}, T{1}, g, rsg, csg, g, rsg, csg, T{0}, g, rsg, csg );
+            return;
+        }
+        for(auto p = size_t{0}; p < x.panels(); p++){
+            auto const xp = x.panel(p);
+            gemm( xp.rows, xp.rows, xp.cols, T{1}, xp.data, xp.rs, xp.cs, xp.data, xp.cs, xp.rs,
+                  p == 0 ? T{0} : T{1}, g, rsg, csg );
+        }
+    }
+
+    /** @brief Returns the Gram matrix of the mode-k unfolding of t as a {n_k, n_k} tensor */
+    template< typename T, typename E, typename F, typename A >
+    tensor<T, dims<dynamic_dims>> gram(tensor<T,E,F,A> const& t, size_t k){
+        auto const x = unfold(t, k);
+        auto const n = ptrdiff_t( x.rows() );
+        auto g = tensor<T, dims<dynamic_dims>>( dims<dynamic_dims>{n, n}, storage_type::uninitialized );
+        gram(x, g.data(), n, ptrdiff_t{1});
+        return g;
+    }
+
+}
+
+#endif // UNFOLD_H
@@ -0,0 +1,40 @@
+// Minimal checking helpers shared by the programs in tests/.
+//
+//   g++ -std=c++17 -Wall -Wextra -fsanitize=address,undefined -Iincludes -pthread tests/<name>.cpp -o t && ./t
+//
+// Every program exits with status 1 if any check failed.
+
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <cstdio>
+
+namespace checks{
+
+    inline int failures = 0;
+
+    inline void check(bool ok, char const* what, char const* file, int line){
+        if( !ok ){
+            ++failures;
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        }
+    }
+
+    /** @brief Prints a summary line and returns the exit status */
+    inline int report(char const* name){
+        std::printf("%s: %s (%d failed)\n", name, failures == 0 ? "ok" : "FAILED", failures);
+        return failures == 0 ? 0 : 1;
+    }
+
+}
+
+#define CHECK(...) ::checks::check( static_cast<bool>(__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__ )
+
+/** @brief Checks that expr throws an exception of type E */
+#define CHECK_THROWS(E, ...) do{ \
+        auto thrown_ = false; \
+        try{ (void)( __VA_ARGS__ ); }catch(E const&){ thrown_ = true; } \
+        ::checks::check( thrown_, "throws " #E ": " #__VA_ARGS__, __FILE__, __LINE__ ); \
+    }while(false)
+
+#endif // TESTS_CHECK_H
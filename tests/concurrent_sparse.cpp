@@ -0,0 +1,109 @@
+// Concurrent sparse storage: parallel add() against a serial sum, updates of compressed entries,
+// copies taken while other threads insert, moved-from objects and adoption as map_compression.
+// Also build with -fsanitize=thread instead of address.
+
+#include "concurrent_sparse.h"
+#include "check.h"
+#include <atomic>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace storage_type::sparse_tensor;
+
+namespace{
+
+    size_t key(size_t i){
+        return ( i * 2654435761u ) % 5000u;
+    }
+
+    void add_range(concurrent_map_compression<long>& s, size_t b, size_t e){
+        for(auto i = b; i < e; i++){
+            s.add(long(i % 7u), key(i));
+        }
+    }
+
+    bool equals(concurrent_map_compression<long>& s, std::map<size_t, long> const& ref, size_t n){
+        auto ok = s.nnz() == ref.size();
+        for(auto k = size_t{0}; ok && k < n; k++){
+            auto const it = ref.find(k);
+            ok = s.at(k) == ( it == ref.end() ? 0 : it->second );
+        }
+        return ok;
+    }
+
+}
+
+int main(){
+    constexpr size_t n = 40000, threads = 4;
+    auto ref = std::map<size_t, long>{};
+    for(auto i = size_t{0}; i < 2u * n; i++){
+        ref[key(i)] += long(i % 7u);
+    }
+
+    auto s = concurrent_map_compression<long>(5000);
+    auto run = [&](size_t first){
+        auto pool = std::vector<std::thread>{};
+        for(auto t = size_t{0}; t < threads; t++){
+            auto const [b, e] = parallel::partition(n, threads, t);
+            pool.emplace_back([&s, first, b = b, e = e]{ add_range(s, first + b, first + e); });
+        }
+        return pool;
+    };
+
+    // first half into the pending shards, then compress, then the second half partly updates compressed entries
+    for(auto& th : run(0)) th.join();
+    s.compress();
+    CHECK( s.index().size() == s.nnz() && std::is_sorted(s.index().begin(), s.index().end()) );
+
+    // copies taken while the second half is being inserted are consistent snapshots
+    auto done = std::atomic<bool>{false};
+    auto copies = std::vector<concurrent_map_compression<long>>{};
+    {
+        auto pool = run(n);
+        auto copier = std::thread([&]{
+            while( !done.load() && copies.size() < 20u ){
+                copies.push_back( concurrent_map_compression<long>(s) );
+            }
+        });
+        for(auto& th : pool) th.join();
+        done = true;
+        copier.join();
+    }
+    CHECK( equals(s, ref, 5000) );
+    for(auto& c : copies){
+        CHECK( c.nnz() <= ref.size() );
+    }
+    s.compress();
+    CHECK( equals(s, ref, 5000) );
+    CHECK( s.uncompress().size() == 5000u );
+
+    s.accumulate(3, 4999u, [](long a, long b){ return a * 10 + b; });
+    auto const before = ref.count(4999u) ? ref[4999u] : 0;
+    CHECK( s.at(4999u) == ( ref.count(4999u) ? before * 10 + 3 : 3 ) );
+    ref[4999u] = s.at(4999u);
+
+    // moved-from storage is empty and usable; move assignment and copy assignment keep the data
+    auto moved = concurrent_map_compression<long>( std::move(s) );
+    CHECK( s.nnz() == 0u && s.at(3) == 0 && s.get(3) == 0 );
+    s.add(5, 3);
+    s.set(6, 4);
+    s.compress();
+    CHECK( s.nnz() == 2u && s.at(3) == 5 && s.at(4) == 6 );
+    CHECK( equals(moved, ref, 5000) );
+    auto assigned = concurrent_map_compression<long>(10);
+    assigned = std::move(moved);
+    CHECK( equals(assigned, ref, 5000) );
+    CHECK( moved.nnz() == 0u );
+    auto copied = concurrent_map_compression<long>(10);
+    copied = assigned;
+    copied = copied;
+    CHECK( equals(copied, ref, 5000) && equals(assigned, ref, 5000) );
+
+    auto m = make_map_compression( std::move(copied), 5000 );
+    auto ok = true;
+    for(auto const& [k, v] : ref) ok = ok && m.at(k) == v;
+    CHECK( ok );
+    CHECK( copied.nnz() == 0u );
+    return checks::report("concurrent_sparse");
+}
@@ -0,0 +1,211 @@
+// gemm, gemv, ger, dot and axpy against loops on strided and transposed operands with sizes that
+// cross the cache blocks, and contract against a brute-force sum over all index pairs, checking
+// that products with a unit m, n or k take the level 1 or 2 kernel whatever the operand shapes.
+
+#define MDSPAN_ENABLE_INSTRUMENTATION
+#include "contraction.h"
+#include "check.h"
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace test;
+using D = dims<dynamic_dims>;
+
+namespace{
+
+    template< typename T >
+    void check_gemm(size_t m, size_t n, size_t k, bool ta, bool tb){
+        auto a = std::vector<T>(m * k), b = std::vector<T>(k * n), c = std::vector<T>(m * n * 2u);
+        for(auto i = size_t{0}; i < a.size(); i++) a[i] = T( int( i * 7u % 19u ) - 9 ) / T(8);
+        for(auto i = size_t{0}; i < b.size(); i++) b[i] = T( int( i * 5u % 17u ) - 8 ) / T(4);
+        for(auto i = size_t{0}; i < c.size(); i++) c[i] = T( int( i % 5u ) );
+        auto ref = c;
+
+        // A and B row-major or transposed, C with row stride 2n so every other column is skipped
+        auto const rsa = ta ? ptrdiff_t{1} : ptrdiff_t(k), csa = ta ? ptrdiff_t(m) : ptrdiff_t{1};
+        auto const rsb = tb ? ptrdiff_t{1} : ptrdiff_t(n), csb = tb ? ptrdiff_t(k) : ptrdiff_t{1};
+        auto const alpha = T(1.5), beta = T(-0.5);
+        gemm( m, n, k, alpha, a.data(), rsa, csa, b.data(), rsb, csb, beta, c.data(), ptrdiff_t(2u * n), ptrdiff_t{2} );
+
+        auto err = T{0};
+        for(auto i = size_t{0}; i < m; i++){
+            for(auto j = size_t{0}; j < n; j++){
+                auto s = T{0};
+                for(auto p = size_t{0}; p < k; p++){
+                    s += a[ptrdiff_t(i) * rsa + ptrdiff_t(p) * csa] * b[ptrdiff_t(p) * rsb + ptrdiff_t(j) * csb];
+                }
+                auto& r = ref[i * 2u * n + j * 2u];
+                r = alpha * s + beta * r;
+            }
+        }
+        for(auto i = size_t{0}; i < c.size(); i++){
+            err = std::max( err, std::fabs( c[i] - ref[i] ) );
+        }
+        CHECK( err <= T(1e-3) * T(k + 1u) );
+    }
+
+    template< typename T >
+    void check_level2(size_t m, size_t n, ptrdiff_t rsa, ptrdiff_t csa, ptrdiff_t inc){
+        auto a = std::vector<T>( size_t( ptrdiff_t(m - 1u) * rsa + ptrdiff_t(n - 1u) * csa + 1 ) );
+        auto x = std::vector<T>( n * size_t(inc) ), z = std::vector<T>( m * size_t(inc) );
+        for(auto i = size_t{0}; i < a.size(); i++) a[i] = T( int( i * 7u % 19u ) - 9 );
+        for(auto i = size_t{0}; i < x.size(); i++) x[i] = T( int( i * 3u % 11u ) - 5 );
+        for(auto i = size_t{0}; i < z.size(); i++) z[i] = T( int( i % 7u ) - 3 );
+        auto const at = [&](size_t i, size_t j){ return a[ ptrdiff_t(i) * rsa + ptrdiff_t(j) * csa ]; };
+
+        // y = 2 A x + beta y; with beta zero y is not read, so NaNs in it do not propagate
+        for(auto beta : {T{0}, T(-1)}){
+            auto y = z;
+            if( beta == T{0} ){
+                for(auto i = size_t{0}; i < m; i++) y[i * size_t(inc)] = std::numeric_limits<T>::quiet_NaN();
+            }
+            gemv( m, n, T(2), a.data(), rsa, csa, x.data(), inc, beta, y.data(), inc );
+            auto ok = true;
+            for(auto i = size_t{0}; i < m; i++){
+                auto s = T{0};
+                for(auto j = size_t{0}; j < n; j++) s += at(i, j) * x[j * size_t(inc)];
+                ok = ok && y[i * size_t(inc)] == T(2) * s + beta * z[i * size_t(inc)];
+            }
+            CHECK( ok );
+        }
+
+        // A += 3 z x^T
+        auto g = a;
+        ger( m, n, T(3), z.data(), inc, x.data(), inc, g.data(), rsa, csa );
+        auto ok = true;
+        for(auto i = size_t{0}; i < m; i++){
+            for(auto j = size_t{0}; j < n; j++){
+                ok = ok && g[ ptrdiff_t(i) * rsa + ptrdiff_t(j) * csa ] == at(i, j) + T(3) * z[i * size_t(inc)] * x[j * size_t(inc)];
+            }
+        }
+        CHECK( ok );
+
+        // dot and axpy along a column of A
+        auto d = T{0};
+        for(auto i = size_t{0}; i < m; i++) d += at(i, 0) * z[i * size_t(inc)];
+        CHECK( dot( m, a.data(), rsa, z.data(), inc ) == d );
+        auto w = z;
+        axpy( m, T(-2), a.data(), rsa, w.data(), inc );
+        ok = true;
+        for(auto i = size_t{0}; i < w.size(); i++){
+            ok = ok && w[i] == ( i % size_t(inc) == 0u ? z[i] - T(2) * at(i / size_t(inc), 0) : z[i] );
+        }
+        CHECK( ok );
+    }
+
+    std::vector<size_t> multi(std::vector<ptrdiff_t> const& e, size_t lin){
+        auto idx = std::vector<size_t>(e.size());
+        for(auto q = e.size(); q-- > 0u;){
+            idx[q] = lin % size_t(e[q]);
+            lin /= size_t(e[q]);
+        }
+        return idx;
+    }
+
+    template< typename T >
+    tensor<T, D> make(D e, unsigned seed){
+        return tensor<T, D>( std::move(e), [seed](size_t i){ return T( int( ( i * 7u + seed ) % 13u ) - 6 ); } );
+    }
+
+    /** @brief c(free a..., free b...) = sum over all (ia, ib) that agree on the contracted modes */
+    template< typename T >
+    std::vector<T> brute(tensor<T, D> const& a, tensor<T, D> const& b, std::vector<size_t> const& ma, std::vector<size_t> const& mb){
+        auto const& ea = a.extents().base();
+        auto const& eb = b.extents().base();
+        auto fa = std::vector<size_t>{}, fb = std::vector<size_t>{};
+        for(auto q = size_t{0}; q < ea.size(); q++) if( std::find(ma.begin(), ma.end(), q) == ma.end() ) fa.push_back(q);
+        for(auto q = size_t{0}; q < eb.size(); q++) if( std::find(mb.begin(), mb.end(), q) == mb.end() ) fb.push_back(q);
+        auto n = size_t{1};
+        for(auto q : fa) n *= size_t(ea[q]);
+        for(auto q : fb) n *= size_t(eb[q]);
+        auto c = std::vector<T>(n);
+        for(auto i = size_t{0}; i < a.size(); i++){
+            auto const ia = multi(ea, i);
+            for(auto j = size_t{0}; j < b.size(); j++){
+                auto const ib = multi(eb, j);
+                auto match = true;
+                for(auto q = size_t{0}; q < ma.size(); q++) match = match && ia[ma[q]] == ib[mb[q]];
+                if( !match ) continue;
+                auto lin = size_t{0};
+                for(auto q : fa) lin = lin * size_t(ea[q]) + ia[q];
+                for(auto q : fb) lin = lin * size_t(eb[q]) + ib[q];
+                c[lin] += a.at(i) * b.at(j);
+            }
+        }
+        return c;
+    }
+
+    template< typename T >
+    void check_contract(D ea, D eb, std::vector<size_t> const& ma, std::vector<size_t> const& mb){
+        auto const a = make<T>(std::move(ea), 1u);
+        auto const b = make<T>(std::move(eb), 4u);
+        auto const c = contract(a, b, ma, mb);
+        auto const ref = brute(a, b, ma, mb);
+        auto ok = c.size() == ref.size();
+        for(auto i = size_t{0}; ok && i < ref.size(); i++){
+            ok = c.at(i) == ref[i];
+        }
+        CHECK( ok );
+    }
+
+    /** @brief Checks the contraction and that it ran kernel, and gemm only if kernel is gemm */
+    void check_path(D ea, D eb, std::vector<size_t> const& ma, std::vector<size_t> const& mb, std::string const& kernel){
+        instrumentation::reset();
+        check_contract<double>( std::move(ea), std::move(eb), ma, mb );
+        auto const s = instrumentation::snapshot();
+        CHECK( s.kernels.count(kernel) == 1u && ( kernel == "gemm" || s.kernels.count("gemm") == 0u ) );
+    }
+
+}
+
+int main(){
+    for(auto ta : {false, true}){
+        for(auto tb : {false, true}){
+            check_gemm<float>(3, 5, 7, ta, tb);
+            check_gemm<double>(37, 29, 300, ta, tb);
+            check_gemm<float>(130, 70, 260, ta, tb);
+        }
+    }
+    {
+        // k == 0 scales C by beta
+        float c[4] = {1, 2, 3, 4};
+        gemm( size_t{2}, size_t{2}, size_t{0}, 1.f, c, 2, 1, c, 2, 1, 2.f, c, 2, 1 );
+        CHECK( c[0] == 2.f && c[3] == 8.f );
+    }
+    check_level2<double>( 37, 29, 29, 1, 1 );      // row-major: dot products
+    check_level2<double>( 37, 29, 1, 37, 1 );      // column-major: column updates
+    check_level2<float>( 5, 300, 2, 11, 3 );       // strided both ways
+    check_level2<float>( 1, 1, 1, 1, 2 );
+
+    check_contract<double>( D{4, 3, 5}, D{3, 5, 6}, {1, 2}, {0, 1} );
+    check_contract<double>( D{4, 3, 5}, D{5, 6, 3}, {2, 1}, {0, 2} );   // b's modes need permuting
+    check_contract<double>( D{3, 4, 2}, D{2, 3}, {0, 2}, {1, 0} );
+    check_contract<double>( D{2, 3}, D{4, 5}, {}, {} );                  // outer product
+    check_contract<double>( D{2, 3}, D{2, 3}, {0, 1}, {0, 1} );          // full contraction
+    check_contract<double>( D{7}, D{7, 3}, {0}, {0} );
+    check_contract<double>( D{3, 7}, D{7}, {1}, {0} );
+    check_contract<double>( D{2, 1, 3}, D{3, 1, 2}, {2, 1}, {0, 1} );
+    check_contract<float>( D{6, 1, 4, 5}, D{5, 4, 1, 3}, {2, 3}, {1, 0} );
+
+    // the kernel follows m, n and k, not the shape classes of the operands
+    check_path( D{4, 5}, D{4, 5}, {0, 1}, {0, 1}, "dot" );              // matrix . matrix over both modes
+    check_path( D{3, 4, 5}, D{5, 3, 4}, {0, 1, 2}, {1, 2, 0}, "dot" );  // permuted tensors
+    check_path( D{1}, D{1}, {0}, {0}, "dot" );
+    check_path( D{2, 3}, D{4, 5}, {}, {}, "ger" );                      // matrix x matrix outer product
+    check_path( D{3, 1}, D{1, 4}, {1}, {0}, "ger" );
+    check_path( D{1}, D{3, 4}, {}, {}, "ger" );                         // a scalar scales the other operand
+    check_path( D{3, 4, 5}, D{4, 5}, {1, 2}, {0, 1}, "gemv" );
+    check_path( D{2, 3, 4}, D{4, 3, 1}, {1, 2}, {1, 0}, "gemv" );       // free mode of b has extent 1
+    check_path( D{1, 4, 5}, D{5, 4, 6}, {1, 2}, {1, 0}, "gemv" );       // free mode of a has extent 1
+    check_path( D{6, 7}, D{7, 5}, {1}, {0}, "gemm" );
+    check_path( D{2, 3, 4}, D{4, 3, 2}, {2}, {0}, "gemm" );
+
+    auto const a = make<float>( D{2, 3}, 0u );
+    CHECK_THROWS( std::length_error, contract(a, a, {0}, {1}) );
+    CHECK_THROWS( std::length_error, contract(a, a, {0}, {0, 1}) );
+    CHECK_THROWS( std::length_error, contract(a, a, {2}, {0}) );
+    CHECK_THROWS( std::length_error, contract(a, a, {1, 1}, {1, 1}) );
+    return checks::report("contraction");
+}
@@ -0,0 +1,146 @@
+// einsum against a brute-force sum over all label assignments, covering diagonals, private labels,
+// batch labels, implicit outputs and three-operand chains, pairs large enough to take gemm, plus
+// the bound on the plan cache.
+
+#define MDSPAN_ENABLE_INSTRUMENTATION
+#include "einsum.h"
+#include "check.h"
+#include <array>
+#include <vector>
+
+using namespace test;
+using D = dims<dynamic_dims>;
+
+namespace{
+
+    tensor<double, D> make(D e, unsigned seed){
+        return tensor<double, D>( std::move(e), [seed](size_t i){ return double( int( ( i * 7u + seed ) % 11u ) - 5 ); } );
+    }
+
+    /** @brief Sums the product of the operands over every assignment of values to the labels */
+    std::vector<double> brute(std::string const& subscripts, std::vector<tensor<double, D> const*> const& ts){
+        auto const arrow = subscripts.find("->");
+        auto inputs = std::vector<std::string>{};
+        for(auto b = size_t{0};;){
+            auto const e = subscripts.find(',', b);
+            inputs.push_back( subscripts.substr(b, std::min(e, arrow) - b) );
+            if( e == std::string::npos || e > arrow ) break;
+            b = e + 1u;
+        }
+        auto extent = std::array<size_t, 128>{};
+        auto labels = std::string{};
+        for(auto i = size_t{0}; i < inputs.size(); i++){
+            for(auto k = size_t{0}; k < inputs[i].size(); k++){
+                auto const c = inputs[i][k];
+                if( labels.find(c) == std::string::npos ) labels.push_back(c);
+                extent[size_t(c)] = size_t( ts[i]->extents()[k] );
+            }
+        }
+        auto const output = subscripts.substr(arrow + 2u);
+        auto n = size_t{1};
+        for(auto c : output) n *= extent[size_t(c)];
+        auto r = std::vector<double>(n);
+
+        auto value = std::array<size_t, 128>{};
+        for(;;){
+            auto p = 1.0;
+            for(auto i = size_t{0}; i < inputs.size(); i++){
+                auto lin = size_t{0};
+                for(auto c : inputs[i]) lin = lin * extent[size_t(c)] + value[size_t(c)];
+                p *= ts[i]->at(lin);
+            }
+            auto o = size_t{0};
+            for(auto c : output) o = o * extent[size_t(c)] + value[size_t(c)];
+            r[o] += p;
+
+            auto q = labels.size();
+            while( q-- > 0u ){
+                auto& v = value[size_t(labels[q])];
+                if( ++v < extent[size_t(labels[q])] ) break;
+                v = 0;
+            }
+            if( q == size_t(-1) ) break;
+        }
+        return r;
+    }
+
+    template< typename ... Ts >
+    void check_einsum(std::string const& subscripts, Ts const& ... ts){
+        auto const c = einsum(subscripts, ts...);
+        auto const ref = brute(subscripts, { &ts... });
+        auto ok = c.size() == ref.size();
+        for(auto i = size_t{0}; ok && i < ref.size(); i++){
+            ok = c.at(i) == ref[i];
+        }
+        CHECK( ok );
+        if( !ok ) std::fprintf(stderr, "  in %s\n", subscripts.c_str());
+    }
+
+}
+
+int main(){
+    auto const a = make( D{4, 5}, 1u );
+    auto const b = make( D{5, 6}, 2u );
+    auto const sq = make( D{5, 5}, 3u );
+    auto const t3 = make( D{3, 4, 5}, 4u );
+    auto const bat = make( D{3, 5, 6}, 5u );
+    auto const v = make( D{6}, 6u );
+
+    check_einsum("ij,jk->ik", a, b);
+    check_einsum("ij,jk->ki", a, b);
+    check_einsum("ij->ji", a);
+    check_einsum("ij->", a);
+    check_einsum("ii->", sq);
+    check_einsum("ii->i", sq);
+    check_einsum("ij,jj->ij", a, sq);
+    check_einsum("bij,bjk->bik", t3, bat);
+    check_einsum("bij,bjk->kb", t3, bat);
+    check_einsum("ijk,jl->il", t3, make( D{4, 2}, 7u ));
+    check_einsum("ij,jk,k->i", a, b, v);
+    check_einsum("ij,jk,kl,l->", a, b, make( D{6, 6}, 8u ), v);
+    check_einsum("i,j->ij", v, v);
+
+    {
+        // m n k of 20 * 20 * 30 per batch is past the direct-loop threshold, so gemm runs
+        auto const x = make( D{2, 20, 30}, 9u );
+        auto const y = make( D{2, 30, 20}, 10u );
+        auto const at = make( D{2, 30, 20}, 11u );
+        instrumentation::reset();
+        check_einsum("bij,bjk->bik", x, y);
+        check_einsum("bij,bjk->bki", x, y);           // transposed output
+        check_einsum("bij,bjk->kib", x, y);
+        check_einsum("bji,bjk->bik", at, y);          // x contracted over its leading mode
+        check_einsum("ij,jk->ki", make( D{40, 50}, 12u ), make( D{50, 30}, 13u ));
+        CHECK( instrumentation::snapshot().kernels.count("gemm") == 1u );
+    }
+
+    // without "->" the output is the labels occurring once, sorted
+    auto const implicit = einsum("jk,ij", b, a);
+    auto const expect = einsum("ij,jk->ik", a, b);
+    auto same = implicit.size() == expect.size();
+    for(auto i = size_t{0}; same && i < expect.size(); i++) same = implicit.at(i) == expect.at(i);
+    CHECK( same );
+
+    CHECK_THROWS( std::invalid_argument, einsum("ij,jk->ik", a) );
+    CHECK_THROWS( std::length_error, einsum("ijk,jk->i", a, b) );
+    CHECK_THROWS( std::length_error, einsum("ij,ij->i", a, b) );
+    CHECK_THROWS( std::invalid_argument, einsum("ij,jk->iz", a, b) );
+    CHECK_THROWS( std::invalid_argument, einsum("ij,jk->ii", a, b) );
+    CHECK_THROWS( std::invalid_argument, einsum("i1,1k->ik", a, b) );
+
+    // every distinct shape is a new plan, but the cache stays bounded and keeps working
+    einsum_clear_cache();
+    for(auto n = ptrdiff_t{1}; n <= ptrdiff_t(test::detail::einsum_plan_cache_capacity) + 44; n++){
+        auto const x = make( D{2, n}, 1u );
+        auto const y = make( D{n, 3}, 2u );
+        auto const z = einsum("ij,jk->ik", x, y);
+        if( n % 50 == 0 ) check_einsum("ij,jk->ik", x, y);
+        CHECK( z.size() == 6u );
+    }
+    CHECK( einsum_cached_plans() == test::detail::einsum_plan_cache_capacity );
+    check_einsum("ij,jk->ik", a, b);
+    CHECK( einsum_cached_plans() == test::detail::einsum_plan_cache_capacity );
+    einsum_clear_cache();
+    CHECK( einsum_cached_plans() == 0u );
+    return checks::report("einsum");
+}
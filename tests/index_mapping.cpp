@@ -0,0 +1,68 @@
+// index_converter against plain division and multiplication, for static, dynamic and
+// dynamic-rank extents and for extents with more than 2^31 elements.
+
+#include "index_mapping.h"
+#include "check.h"
+#include <vector>
+
+using namespace mdspan;
+
+namespace{
+
+    template< typename E >
+    void naive_multi(E const& e, size_t lin, ptrdiff_t* idx){
+        for(auto k = e.rank(); k-- > 0;){
+            auto const n = static_cast<size_t>( e.extent(k) );
+            idx[k] = static_cast<ptrdiff_t>( lin % n );
+            lin /= n;
+        }
+    }
+
+    template< typename E >
+    void check_converter(E const& e, std::vector<size_t> const& lins){
+        auto const conv = index_converter<E>(e);
+        auto const r = static_cast<size_t>( e.rank() );
+        auto idx = std::vector<ptrdiff_t>(r), ref = std::vector<ptrdiff_t>(r);
+        for(auto lin : lins){
+            conv.to_multi(lin, idx.data());
+            naive_multi(e, lin, ref.data());
+            CHECK( idx == ref );
+            CHECK( conv.to_linear(idx.data()) == lin );
+        }
+        auto batch = std::vector<ptrdiff_t>( r * lins.size() );
+        conv.to_multi(lins.data(), lins.data() + lins.size(), batch.data());
+        for(auto i = size_t{0}; i < lins.size(); i++){
+            naive_multi(e, lins[i], ref.data());
+            for(auto k = size_t{0}; k < r; k++){
+                CHECK( batch[k * lins.size() + i] == ref[k] );
+            }
+        }
+    }
+
+    std::vector<size_t> all(size_t n){
+        auto v = std::vector<size_t>(n);
+        for(auto i = size_t{0}; i < n; i++){
+            v[i] = i;
+        }
+        return v;
+    }
+
+}
+
+int main(){
+    check_converter( extents<3,3,4,5>{}, all(60) );
+    check_converter( extents<4,3,dynamic_extent,7,dynamic_extent>{6, 9}, all(3 * 6 * 7 * 9) );
+    check_converter( extents<dynamic_dims>{7, 1, 13, 2, 3}, all(7 * 13 * 2 * 3) );
+
+    // more than 2^31 elements takes the 64-bit path; sample the whole range including the last index
+    auto const big = extents<dynamic_dims>{70001, 40009, 3};
+    auto const n = size_t{70001} * 40009u * 3u;
+    auto lins = std::vector<size_t>{};
+    for(auto i = size_t{0}; i < 1000; i++){
+        lins.push_back( ( i * 0x9E3779B97F4A7C15ull ) % n );
+    }
+    lins.push_back(n - 1u);
+    check_converter( big, lins );
+
+    return checks::report("index_mapping");
+}
@@ -0,0 +1,116 @@
+// index_table lookups against std::lower_bound for dense, sparse, clustered and huge indices, with
+// keys beyond the universe up to SIZE_MAX, single and batched; map_compression::gather against
+// at() with pending insertions, and the sparse.at count of a gather.
+
+#define MDSPAN_ENABLE_INSTRUMENTATION
+#include "storage_policy.h"
+#include "check.h"
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace storage_type::sparse_tensor;
+
+namespace{
+
+    constexpr auto top = std::numeric_limits<size_t>::max();
+
+    size_t reference(std::vector<size_t> const& index, size_t k){
+        auto const it = std::lower_bound(index.begin(), index.end(), k);
+        return it != index.end() && *it == k ? size_t( it - index.begin() ) : index_table::npos;
+    }
+
+    /** @brief Every stored index, its neighbours and the extreme keys, found singly and in batches */
+    void check_table(std::set<size_t> const& s, size_t expected_shift = top){
+        auto const index = std::vector<size_t>(s.begin(), s.end());
+        auto const t = index_table(index);
+        if( expected_shift != top ){
+            CHECK( t.shift() == expected_shift );
+        }
+
+        auto keys = std::vector<size_t>{ 0u, 1u, 2u, top, top - 1u, top - 2u, top >> 1u };
+        for(auto k : index){
+            keys.push_back(k);
+            keys.push_back(k + 1u);
+            keys.push_back(k - 1u);
+            keys.push_back(k + ( size_t{1} << 20u ));
+        }
+        auto g = std::mt19937_64(7u);
+        for(auto i = 0; i < 500; i++){
+            keys.push_back( g() );
+            keys.push_back( index.empty() || index.back() > top - 2u ? g() % 64u : g() % ( index.back() + 2u ) );
+        }
+
+        auto ok = true;
+        for(auto k : keys){
+            ok = ok && t.find(index, k) == reference(index, k);
+        }
+        CHECK( ok );
+
+        // batches that do not fill the last group of 32
+        for(auto n : {keys.size(), size_t{31}, size_t{1}, size_t{0}}){
+            auto pos = std::vector<size_t>(n + 1u, 12345u);
+            t.find(index, keys.data(), n, pos.data());
+            ok = pos[n] == 12345u;
+            for(auto i = size_t{0}; i < n; i++){
+                ok = ok && pos[i] == reference(index, keys[i]);
+            }
+            CHECK( ok );
+        }
+    }
+
+}
+
+int main(){
+    check_table( {} );
+    check_table( {0u}, 0u );
+    check_table( {5u} );
+    {
+        // as many indices as the universe: shift 0, where k >> shift is k itself
+        auto s = std::set<size_t>{};
+        for(auto k = size_t{0}; k < 100u; k++) s.insert(k);
+        check_table( s, 0u );
+        s.erase(50u);
+        check_table( s, 1u );
+    }
+    {
+        auto g = std::mt19937_64(1u);
+        auto s = std::set<size_t>{};
+        while( s.size() < 1000u ) s.insert( g() % 1000000u );
+        check_table( s );
+        // a crowded bucket is binary searched
+        for(auto k = size_t{500000}; k < 500100u; k++) s.insert(k);
+        check_table( s );
+    }
+    check_table( {3u, top - 1u} );              // the universe is SIZE_MAX
+    check_table( {0u, 1u, 2u, top / 2u} );
+
+    {
+        auto const n = size_t{10000};
+        auto m = map_compression<int>(n);
+        auto g = std::mt19937_64(3u);
+        for(auto i = 0; i < 2000; i++){
+            auto const k = g() % n;
+            m.set( int(k % 97u) + 1, k );
+        }
+        m.compress();
+        // set() after compress() updates in place or stays pending; gather sees both
+        m.set( -1, n - 1u );
+        m.set( -2, 0u );
+        auto keys = std::vector<size_t>{};
+        for(auto k = size_t{0}; k < n; k += 3u) keys.push_back(k);
+        keys.push_back(n - 1u);
+        auto out = std::vector<int>(keys.size());
+        instrumentation::reset();
+        m.gather(keys.data(), keys.size(), out.data());
+        CHECK( instrumentation::snapshot()[instrumentation::counter::sparse_at] == keys.size() );
+        auto ok = true;
+        for(auto i = size_t{0}; i < keys.size(); i++){
+            ok = ok && out[i] == m.at(keys[i]);
+        }
+        CHECK( ok && out.back() == -1 && out.front() == -2 );
+    }
+    return checks::report("index_table");
+}
@@ -0,0 +1,71 @@
+// Instrumentation counters and kernel timers: per-thread counters survive thread exit, allocations
+// count bytes, scoped kernels record calls and bytes, and reset() zeroes everything.
+
+#define MDSPAN_ENABLE_INSTRUMENTATION
+#include "tensor.h"
+#include "instrumentation.h"
+#include "check.h"
+#include <thread>
+#include <vector>
+
+using namespace test;
+using namespace instrumentation;
+
+int main(){
+    using M = storage_type::sparse_tensor::map_compression<int>;
+    using D = dims<mdspan::dynamic_dims>;
+
+    reset();
+    auto t = tensor<int, D, int, storage_type::dense_tensor::dense<int, std::vector<int>>>( D{4, 4} );
+    t.set(1, 0);
+    t.set(2, 1);
+    auto const& ct = t;
+    auto sum = ct.at(0) + ct.at(1) + ct.at(2);
+    auto s = snapshot();
+    CHECK( sum == 3 );
+    CHECK( s[counter::dense_set] == 2u );
+    CHECK( s[counter::dense_at] == 3u );
+    CHECK( s[counter::storage_allocations] == 1u && s[counter::storage_bytes] == 16u * sizeof(int) );
+
+    // counters of threads that have exited are kept
+    reset();
+    auto workers = std::vector<std::thread>{};
+    for(auto i = 0; i < 4; i++){
+        workers.emplace_back([]{
+            for(auto j = 0; j < 1000; j++){
+                count(counter::sparse_get);
+            }
+        });
+    }
+    for(auto& w : workers){
+        w.join();
+    }
+    CHECK( snapshot()[counter::sparse_get] == 4000u );
+
+    reset();
+    auto u = tensor<int, D, int, M>( D{8} );
+    u.set(5, 2);
+    CHECK( u.at(2) == 5 && u.at(3) == 0 );
+    s = snapshot();
+    CHECK( s[counter::sparse_set] == 1u && s[counter::sparse_at] == 2u );
+
+    reset();
+    {
+        auto k = scoped_kernel("test.kernel", 100);
+        k.add_bytes(28);
+    }
+    {
+        auto k = scoped_kernel("test.kernel", 10);
+    }
+    s = snapshot();
+    CHECK( s.kernels.count("test.kernel") == 1u );
+    CHECK( s.kernels["test.kernel"].calls == 2u && s.kernels["test.kernel"].bytes == 138u );
+    auto keys = 0;
+    s.for_each([&](std::string const&, std::uint64_t){ ++keys; });
+    CHECK( keys == int(counter_count) + 3 );
+
+    reset();
+    s = snapshot();
+    CHECK( s.kernels.empty() && s[counter::sparse_get] == 0u && s[counter::sparse_at] == 0u );
+    return checks::report("instrumentation");
+}
@@ -0,0 +1,81 @@
+// layout_right mappings against row-major offsets computed by hand, for static, partially static
+// and dynamic-rank extents, and the compile-time strides of static modes.
+
+#include "layout.h"
+#include "tensor.h"
+#include "check.h"
+#include <vector>
+
+using namespace mdspan;
+
+namespace{
+
+    /** @brief Checks every multi-index of e against the last-index-fastest enumeration */
+    template< typename M >
+    void check_mapping(M const& m, std::vector<ptrdiff_t> const& e){
+        auto const n = static_cast<size_t>( m.required_span_size() );
+        auto idx = std::vector<ptrdiff_t>(e.size(), 0);
+        auto ok = true;
+        for(auto lin = size_t{0}; lin < n; lin++){
+            ok = ok && m( idx.data() ) == ptrdiff_t(lin);
+            for(auto k = e.size(); k-- > 0u;){
+                if( ++idx[k] < e[k] ) break;
+                idx[k] = 0;
+            }
+        }
+        CHECK( ok );
+        auto s = ptrdiff_t{1};
+        for(auto k = e.size(); k-- > 0u;){
+            CHECK( m.stride(k) == s );
+            s *= e[k];
+        }
+    }
+
+}
+
+int main(){
+    {
+        using E = extents<4,dynamic_extent,8,dynamic_extent,3>;
+        using M = layout_right::mapping<E>;
+        static_assert( M::static_stride(0) == dynamic_extent && M::static_stride(1) == dynamic_extent );
+        static_assert( M::static_stride(2) == 3 && M::static_stride(3) == 1 );
+        static_assert( M::rank_dynamic_strides() == 2 );
+        auto const m = M( E{5, 7} );
+        check_mapping( m, {5, 8, 7, 3} );
+        CHECK( m(4, 7, 6, 2) == 5 * 8 * 7 * 3 - 1 );
+        CHECK( m.stride<2>() == 3 && m.stride<0>() == 8 * 7 * 3 );
+    }
+    {
+        using E = extents<3,2,3,4>;
+        using M = layout_right::mapping<E>;
+        static_assert( M::rank_dynamic_strides() == 0 );
+        constexpr auto m = M( E{} );
+        static_assert( m(1, 2, 3) == 23 && m.required_span_size() == 24 );
+        check_mapping( m, {2, 3, 4} );
+    }
+    {
+        using E = extents<2,dynamic_extent,6>;
+        check_mapping( layout_right::mapping<E>( E{9} ), {9, 6} );
+    }
+    {
+        auto const e = extents<dynamic_dims>{3, 1, 4, 2};
+        auto const m = layout_right::mapping< extents<dynamic_dims> >(e);
+        CHECK( m.rank() == 4u );
+        check_mapping( m, {3, 1, 4, 2} );
+        CHECK( m(2, 0, 3, 1) == 23 );
+    }
+    {
+        // the mapping of a tensor addresses the same elements as at()
+        using D = test::dims<2,dynamic_extent,5>;
+        auto t = test::tensor<int, D>( D{3}, [](size_t k){ return int(k); } );
+        auto const m = t.mapping();
+        auto ok = true;
+        for(auto i = 0; i < 3; i++){
+            for(auto j = 0; j < 5; j++){
+                ok = ok && t.data()[ m(i, j) ] == i * 5 + j;
+            }
+        }
+        CHECK( ok );
+    }
+    return checks::report("layout");
+}
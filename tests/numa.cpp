@@ -0,0 +1,115 @@
+// NUMA allocation and the parallel element-wise kernels: topology parsing, allocator round trips,
+// parallel initialization of numa vectors, pinning restored afterwards, and the kernels against
+// serial loops for several thread counts, and the overflow and interleave-fallback paths of the
+// allocator. Runs on single-node machines too.
+
+#define MDSPAN_ENABLE_INSTRUMENTATION
+#include "tensor_parallel.h"
+#include "check.h"
+#include <limits>
+#include <numeric>
+#include <vector>
+
+using namespace test;
+using D = dims<dynamic_dims>;
+
+namespace{
+
+#if defined(__linux__)
+    bool same_affinity(cpu_set_t const& a){
+        auto b = cpu_set_t{};
+        CPU_ZERO(&b);
+        ::sched_getaffinity(0, sizeof(b), &b);
+        return CPU_EQUAL(&a, &b);
+    }
+#endif
+
+    template< typename A >
+    void check_kernels(size_t threads){
+        using T = tensor<double, D, int, A>;
+        auto a = T( D{7, 301}, [](size_t k){ return double(k % 17u); } );
+        auto c = T( D{7, 301}, 2.0 );
+        auto out = T( D{7, 301}, storage_type::uninitialized );
+        auto ok = true;
+        for(auto k = size_t{0}; k < a.size(); k++){
+            ok = ok && a.data()[k] == double(k % 17u) && c.data()[k] == 2.0;
+        }
+        CHECK( ok );
+
+        parallel_transform(a, out, [](double x){ return x + 1.0; }, threads);
+        ok = true;
+        for(auto k = size_t{0}; k < a.size(); k++) ok = ok && out.data()[k] == double(k % 17u) + 1.0;
+        CHECK( ok );
+
+        parallel_transform(a, c, out, [](double x, double y){ return x * y; }, threads);
+        ok = true;
+        for(auto k = size_t{0}; k < a.size(); k++) ok = ok && out.data()[k] == 2.0 * double(k % 17u);
+        CHECK( ok );
+
+        auto ref = 0.0;
+        for(auto k = size_t{0}; k < a.size(); k++) ref += a.data()[k];
+        CHECK( parallel_reduce(a, 0.0, std::plus<>{}, threads) == ref );
+
+        parallel_fill(out, -1.0, threads);
+        CHECK( std::all_of(out.data(), out.data() + out.size(), [](double x){ return x == -1.0; }) );
+    }
+
+}
+
+int main(){
+    CHECK( numa::detail::parse_list("0-3,8,10-11\n") == std::vector<int>({0, 1, 2, 3, 8, 10, 11}) );
+    CHECK( numa::detail::parse_list("5") == std::vector<int>({5}) );
+    CHECK( numa::detail::parse_list("").empty() );
+
+    auto const& topo = numa::topology();
+    CHECK( !topo.nodes.empty() && topo.cpus.size() == topo.cpu_node.size() );
+    CHECK( numa::node_count() >= 1u );
+    for(auto parts : {size_t{1}, size_t{3}, size_t{64}}){
+        for(auto t = size_t{0}; t < parts; t++){
+            auto const cpu = numa::cpu_of_part(t, parts);
+            CHECK( topo.cpus.empty() ? cpu == -1 : std::find(topo.cpus.begin(), topo.cpus.end(), cpu) != topo.cpus.end() );
+        }
+    }
+
+#if defined(__linux__)
+    auto before = cpu_set_t{};
+    CPU_ZERO(&before);
+    ::sched_getaffinity(0, sizeof(before), &before);
+    {
+        auto const pin = numa::scoped_pin( numa::cpu_of_part(0, 1) );
+    }
+    CHECK( same_affinity(before) );
+    numa::parallel_for(100, [](size_t, size_t, size_t){}, 4);
+    CHECK( same_affinity(before) );
+#endif
+
+    auto empty = numa::first_touch_vector<int>{};
+    empty.resize(0);
+    empty.shrink_to_fit();
+    auto v = numa::interleaved_vector<int>(10000);
+    std::iota(v.begin(), v.end(), 0);
+    v.resize(20000, 7);
+    CHECK( v[9999] == 9999 && v[19999] == 7 );
+    {
+        using A = numa::allocator<double, numa::policy::interleave>;
+        CHECK_THROWS( std::bad_array_new_length, A{}.allocate( std::numeric_limits<size_t>::max() / 4u ) );
+#if defined(__linux__)
+        // a refused interleave policy is counted, and the memory is usable either way
+        auto const n = size_t{4096};
+        instrumentation::reset();
+        auto* p = A{}.allocate(n);
+        auto const fell_back = !numa::interleave(p, n * sizeof(double));
+        CHECK( instrumentation::snapshot()[instrumentation::counter::numa_fallbacks] == ( fell_back ? 1u : 0u ) );
+        std::fill(p, p + n, 1.5);
+        CHECK( p[n - 1u] == 1.5 );
+        A{}.deallocate(p, n);
+#endif
+    }
+
+    for(auto threads : {size_t{1}, size_t{3}, size_t{16}}){
+        check_kernels< numa::first_touch_vector<double> >(threads);
+        check_kernels< numa::interleaved_vector<double> >(threads);
+        check_kernels< std::vector<double> >(threads);
+    }
+    return checks::report("numa");
+}
@@ -0,0 +1,102 @@
+// layout_right_padded strides, span sizes and for_each_offset against the row-major enumeration,
+// with strides at the critical stride and at its power-of-two fractions.
+
+#include "layout.h"
+#include "check.h"
+#include <vector>
+
+using namespace mdspan;
+
+namespace{
+
+    using P = layout_right_padded<16,1024>;
+
+    /** @brief Checks that for_each_offset visits m(idx) for every idx in row-major order, once each */
+    template< typename M >
+    void check_offsets(M const& m, std::vector<ptrdiff_t> const& e){
+        auto expected = std::vector<ptrdiff_t>{};
+        auto idx = std::vector<ptrdiff_t>(e.size(), 0);
+        auto n = ptrdiff_t{1};
+        for(auto x : e) n *= x;
+        for(auto lin = ptrdiff_t{0}; lin < n; lin++){
+            expected.push_back( m( idx.data() ) );
+            for(auto k = e.size(); k-- > 0u;){
+                if( ++idx[k] < e[k] ) break;
+                idx[k] = 0;
+            }
+        }
+        auto visited = std::vector<ptrdiff_t>{};
+        for_each_offset( m, [&](ptrdiff_t off){ visited.push_back(off); } );
+        CHECK( visited == expected );
+
+        auto seen = std::vector<int>( static_cast<size_t>( m.required_span_size() ), 0 );
+        auto ok = true;
+        for(auto off : visited){
+            ok = ok && off >= 0 && off < m.required_span_size() && ++seen[ static_cast<size_t>(off) ] == 1;
+        }
+        CHECK( ok );
+    }
+
+}
+
+int main(){
+    {
+        static_assert( P::fold_stride == 128 );
+        // multiples of Critical / 8 are padded, whichever power of two they are
+        static_assert( P::padded_stride(1024) == 1040 && P::padded_stride(2048) == 2064 );
+        static_assert( P::padded_stride(512) == 528 && P::padded_stride(256) == 272 );
+        static_assert( P::padded_stride(128) == 144 && P::padded_stride(384) == 400 );
+        // other strides are only rounded up to Align
+        static_assert( P::padded_stride(16) == 16 && P::padded_stride(64) == 64 );
+        static_assert( P::padded_stride(1000) == 1008 && P::padded_stride(100) == 112 );
+        static_assert( P::padded_stride(3) == 3 && P::padded_stride(1) == 1 );
+        // no padded stride is a multiple of the fold stride, and padding adds at most two vectors
+        auto ok = true;
+        for(auto x = ptrdiff_t{1}; x < 8192; x++){
+            auto const p = P::padded_stride(x);
+            ok = ok && p >= x && p % P::fold_stride != 0 && ( x < 16 ? p == x : p % 16 == 0 && p - x < 32 );
+        }
+        CHECK( ok );
+    }
+    {
+        auto const m = P::mapping< extents<dynamic_dims> >( extents<dynamic_dims>{16, 1024, 1024} );
+        CHECK( m.stride(2) == 1 && m.stride(1) == 1040 && m.stride(0) == 1040 * 1024 + 16 );
+        CHECK( m.required_span_size() == 16 * ( 1040 * 1024 + 16 ) );
+        CHECK( m(1, 2, 3) == 1040 * 1024 + 16 + 2 * 1040 + 3 );
+    }
+    {
+        auto const m = P::mapping< extents<dynamic_dims> >( extents<dynamic_dims>{16, 512, 512} );
+        CHECK( m.stride(1) == 528 && m.stride(0) == 528 * 512 + 16 );
+        CHECK( m.required_span_size() == 16 * ( 528 * 512 + 16 ) );
+    }
+    {
+        // odd extents keep their rows, only rounded to Align
+        auto const e = extents<dynamic_dims>{3, 5, 20};
+        auto const m = P::mapping< extents<dynamic_dims> >(e);
+        CHECK( m.stride(1) == 32 && m.stride(0) == 160 );
+        check_offsets( m, {3, 5, 20} );
+    }
+    {
+        auto const e = extents<dynamic_dims>{4, 6, 128};
+        auto const m = P::mapping< extents<dynamic_dims> >(e);
+        CHECK( m.stride(1) == 144 && m.stride(0) == 864 );
+        check_offsets( m, {4, 6, 128} );
+    }
+    {
+        using E = extents<3,2,3,256>;
+        auto const m = P::mapping<E>( E{} );
+        CHECK( m.stride(1) == 272 && m.stride(0) == 3 * 272 );
+        check_offsets( m, {2, 3, 256} );
+    }
+    {
+        // 64 byte vectors and a 4 KiB critical stride
+        using F = layout_padded_for<float>;
+        using D = layout_padded_for<double>;
+        static_assert( F::padded_stride(1024) == 1040 && F::padded_stride(512) == 528 );
+        static_assert( D::padded_stride(512) == 520 && D::padded_stride(64) == 72 && D::padded_stride(32) == 32 );
+        auto const m = D::mapping< extents<dynamic_dims> >( extents<dynamic_dims>{2, 3, 64} );
+        CHECK( m.stride(1) == 72 && m.stride(0) == 216 );
+        check_offsets( m, {2, 3, 64} );
+    }
+    return checks::report("padded_layout");
+}
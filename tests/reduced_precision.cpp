@@ -0,0 +1,119 @@
+// fp16 and bf16 conversions checked exhaustively over all 2^16 encodings, bulk conversions against
+// the scalar ones, and block-scaled int8 storage against its error bound. Build once more with
+// -march=native to cover the F16C kernels.
+
+#include "reduced_precision.h"
+#include "tensor.h"
+#include "check.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace storage_type;
+using precision::bits;
+using precision::from_bits;
+
+namespace{
+
+    bool same(float a, float b){
+        return ( std::isnan(a) && std::isnan(b) ) || bits(a) == bits(b);
+    }
+
+    /** @brief Every finite encoding round-trips, and midpoints between neighbours round to even */
+    template< typename Format >
+    void check_format(){
+        auto round_trip = true, ties = true, nan = true;
+        for(auto u = 0u; u < 0x10000u; u++){
+            auto const h = static_cast<std::uint16_t>(u);
+            auto const a = Format::decode(h);
+            if( std::isnan(a) ){
+                nan = nan && std::isnan( Format::decode( Format::encode(a) ) );
+                continue;
+            }
+            round_trip = round_trip && Format::encode(a) == h;
+            auto const h1 = static_cast<std::uint16_t>(u + 1u);
+            auto const b = Format::decode(h1);
+            if( ( u & 0x7fffu ) == 0x7fffu || std::isinf(a) || !std::isfinite(b) ){
+                continue;
+            }
+            auto const mid = static_cast<float>( ( double(a) + double(b) ) / 2.0 );
+            auto const even = ( u & 1u ) == 0u ? h : h1;
+            ties = ties && Format::encode(mid) == even
+                        && Format::encode( std::nextafter(mid, a) ) == h
+                        && Format::encode( std::nextafter(mid, b) ) == h1;
+        }
+        CHECK( round_trip );
+        CHECK( ties );
+        CHECK( nan );
+
+        auto g = std::mt19937(3);
+        auto d = std::uniform_real_distribution<float>(-70000.f, 70000.f);
+        auto in = std::vector<float>(1003);
+        for(auto& x : in){
+            x = d(g) * ( d(g) > 0.f ? 1.f : 1e-6f );
+        }
+        in[5] = std::numeric_limits<float>::infinity();
+        in[6] = std::numeric_limits<float>::quiet_NaN();
+        in[7] = -0.f;
+        auto enc = std::vector<std::uint16_t>(in.size());
+        auto dec = std::vector<float>(in.size());
+        Format::encode(in.data(), enc.data(), in.size());
+        Format::decode(enc.data(), dec.data(), in.size());
+        auto bulk = true;
+        for(auto i = size_t{0}; i < in.size(); i++){
+            bulk = bulk && ( enc[i] == Format::encode(in[i]) || std::isnan(in[i]) )
+                        && same( dec[i], Format::decode(enc[i]) );
+        }
+        CHECK( bulk );
+    }
+
+}
+
+int main(){
+    check_format<precision::fp16>();
+    check_format<precision::bf16>();
+    CHECK( std::isinf( precision::fp16::decode( precision::fp16::encode(65520.f) ) ) );
+    CHECK( precision::fp16::decode( precision::fp16::encode(65519.f) ) == 65504.f );
+
+    using D = test::dims<mdspan::dynamic_dims>;
+    {
+        using S = dense_tensor::reduced_dense<float, precision::bf16>;
+        auto t = test::tensor<float, D, int, S>( D{3, 5}, [](size_t k){ return float(k) * 0.5f; } );
+        auto ok = true;
+        for(auto k = size_t{0}; k < t.size(); k++){
+            ok = ok && t.at(k) == float(k) * 0.5f;
+        }
+        CHECK( ok );
+        t.set(1.f / 3.f, 4);
+        CHECK( t.at(4) == precision::bf16::decode( precision::bf16::encode(1.f / 3.f) ) );
+        CHECK( test::tensor<float, D, int, S>( D{7}, 2.f ).at(6) == 2.f );
+    }
+    {
+        constexpr size_t block = 16;
+        using S = dense_tensor::block_int8_dense<float, block>;
+        auto g = std::mt19937(5);
+        auto d = std::uniform_real_distribution<float>(-4.f, 4.f);
+        auto ref = std::vector<float>(100);
+        for(auto& x : ref){
+            x = d(g);
+        }
+        auto t = test::tensor<float, D, int, S>( D{100}, [&](size_t k){ return ref[k]; } );
+        auto ok = true;
+        for(auto k = size_t{0}; k < ref.size(); k++){
+            // |x - q * s| <= s / 2 with s the scale of the block
+            ok = ok && std::fabs( t.at(k) - ref[k] ) <= t.base().scales()[k / block] * 0.5f + 1e-6f;
+        }
+        CHECK( ok );
+
+        // set() re-quantizes the block it touches, including the partial last block
+        ref[99] = 100.f;
+        t.set(100.f, 99);
+        CHECK( std::fabs( t.at(99) - 100.f ) < 1e-4f );
+        CHECK( std::fabs( t.at(97) - ref[97] ) <= 100.f / 127.f / 2.f + 1e-6f );
+        CHECK( std::fabs( t.at(95) - ref[95] ) <= t.base().scales()[5] * 0.5f + 1e-6f );
+
+        auto z = test::tensor<float, D, int, S>( D{40} );
+        CHECK( z.at(39) == 0.f && z.base().bytes() == 40u + 3u * sizeof(float) );
+    }
+    return checks::report("reduced_precision");
+}
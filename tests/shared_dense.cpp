@@ -0,0 +1,80 @@
+// Copy-on-write semantics of shared_dense: sharing, detaching, escaped references and moved-from
+// objects, and tensor::clone.
+
+#include "tensor.h"
+#include "check.h"
+#include <vector>
+
+using S = storage_type::dense_tensor::shared_dense<int>;
+
+int main(){
+    {
+        auto a = S( std::vector<int>{1, 2, 3} );
+        auto b = a;
+        CHECK( a.use_count() == 2u && b.use_count() == 2u );
+        CHECK( static_cast<S const&>(a).data() == static_cast<S const&>(b).data() );
+        b.set(7, 0);
+        CHECK( a.unique() && b.unique() );
+        CHECK( static_cast<S const&>(a).at(0) == 1 && static_cast<S const&>(b).at(0) == 7 );
+    }
+    {
+        // a reference handed out by at() must not be shared with later copies
+        auto a = S( std::vector<int>{1, 2, 3} );
+        int& r = a.at(0);
+        auto b = S(a);
+        r = 42;
+        CHECK( static_cast<S const&>(b).at(0) == 1 );
+        CHECK( static_cast<S const&>(a).at(0) == 42 );
+        auto c = S( std::vector<int>{} );
+        c = a;
+        CHECK( static_cast<S const&>(c).data() != static_cast<S const&>(a).data() );
+    }
+    {
+        auto a = S( std::vector<int>{1, 2, 3} );
+        int* p = a.data();
+        auto b = a;
+        p[1] = 5;
+        CHECK( static_cast<S const&>(b).at(1) == 2 );
+    }
+    {
+        auto a = S( std::vector<int>{1, 2, 3} );
+        auto b = S( std::move(a) );
+        CHECK( a.size() == 0u && a.use_count() == 0u && a.unique() );
+        CHECK( static_cast<S const&>(a).data() == nullptr );
+        auto c = a;
+        CHECK( c.size() == 0u );
+        CHECK( a.clone().size() == 0u );
+        a = b;
+        CHECK( a.size() == 3u && a.use_count() == 2u );
+        auto d = S( std::move(a) );
+        a = S( std::vector<int>{9} );
+        CHECK( static_cast<S const&>(a).at(0) == 9 && d.size() == 3u );
+    }
+    {
+        using T = test::tensor<int, test::dims<mdspan::dynamic_dims>, int, S>;
+        auto t = T( test::dims<mdspan::dynamic_dims>{2, 3}, 4 );
+        auto u = t;
+        auto v = t.clone();
+        CHECK( t.base().use_count() == 2u && v.base().unique() );
+        u.set(1, 5);
+        CHECK( t.at(5) == 4 && u.at(5) == 1 && v.at(5) == 4 );
+    }
+    {
+        // reads through the const path keep the buffer shared with later copies
+        using T = test::tensor<int, test::dims<mdspan::dynamic_dims>, int, S>;
+        auto t = T( test::dims<mdspan::dynamic_dims>{2, 3}, [](size_t k){ return int(k); } );
+        auto u = t;
+        auto sum = 0;
+        for(auto k = size_t{0}; k < t.size(); k++) sum += t.as_const().at(k);
+        auto const* p = t.as_const().data();
+        CHECK( sum == 15 && p == u.as_const().data() && t.base().use_count() == 2u );
+        auto w = t;
+        CHECK( t.base().use_count() == 3u && w.as_const().data() == p );
+        CHECK( t.base().as_const().at(4) == 4 && t.base().use_count() == 3u );
+        // a non-const read detaches and makes later copies deep
+        CHECK( t.at(4) == 4 && t.base().unique() && u.base().use_count() == 2u );
+        auto x = t;
+        CHECK( t.base().unique() && x.base().unique() && x.as_const().data() != t.as_const().data() );
+    }
+    return checks::report("shared_dense");
+}
@@ -0,0 +1,135 @@
+// Parallel sparse construction against std::map: sort_entries with duplicates and custom
+// combines, csr and csf layouts, for several thread counts and empty inputs.
+
+#include "sparse_builder.h"
+#include "check.h"
+#include <map>
+#include <random>
+#include <vector>
+
+using namespace storage_type::sparse_tensor;
+
+namespace{
+
+    struct coo{
+        std::vector<size_t> index;
+        std::vector<long> values;
+    };
+
+    coo random_entries(size_t n, size_t universe, unsigned seed){
+        auto g = std::mt19937_64(seed);
+        auto c = coo{};
+        for(auto i = size_t{0}; i < n; i++){
+            c.index.push_back( g() % universe );
+            c.values.push_back( long( g() % 100u ) - 50 );
+        }
+        return c;
+    }
+
+    void check_sort(coo const& c, size_t universe, size_t threads){
+        auto ref = std::map<size_t, long>{};
+        auto last = std::map<size_t, long>{};
+        for(auto i = size_t{0}; i < c.index.size(); i++){
+            ref[c.index[i]] += c.values[i];
+            last[c.index[i]] = c.values[i];
+        }
+        auto const s = sort_entries( c.index.data(), c.values.data(), c.index.size(), universe, std::plus<>{}, threads );
+        auto ok = s.index.size() == ref.size() && s.values.size() == ref.size();
+        auto it = ref.begin();
+        for(auto i = size_t{0}; ok && i < s.index.size(); i++, it++){
+            ok = s.index[i] == it->first && s.values[i] == it->second;
+        }
+        CHECK( ok );
+
+        // duplicates are folded in input order, so "keep the right operand" keeps the last value
+        auto const r = sort_entries( c.index.data(), c.values.data(), c.index.size(), universe,
+                                     [](long, long b){ return b; }, threads );
+        ok = r.index.size() == last.size();
+        auto jt = last.begin();
+        for(auto i = size_t{0}; ok && i < r.index.size(); i++, jt++){
+            ok = r.index[i] == jt->first && r.values[i] == jt->second;
+        }
+        CHECK( ok );
+    }
+
+    void check_csr(coo const& c, size_t rows, size_t cols, size_t threads){
+        auto ref = std::map<size_t, long>{};
+        for(auto i = size_t{0}; i < c.index.size(); i++){
+            ref[c.index[i]] += c.values[i];
+        }
+        auto m = make_csr( sort_entries( c.index.data(), c.values.data(), c.index.size(), rows * cols, std::plus<>{}, threads ),
+                           rows, cols, threads );
+        auto ok = m.row_ptr.size() == rows + 1u && m.row_ptr[0] == 0u && m.row_ptr[rows] == ref.size();
+        auto it = ref.begin();
+        for(auto r = size_t{0}; ok && r < rows; r++){
+            for(auto k = m.row_ptr[r]; ok && k < m.row_ptr[r + 1u]; k++, it++){
+                ok = it->first == r * cols + m.col_index[k] && m.values[k] == it->second;
+            }
+        }
+        CHECK( ok && it == ref.end() );
+    }
+
+    template< typename E >
+    void check_csf(coo const& c, E const& e, size_t threads){
+        auto ref = std::map<size_t, long>{};
+        for(auto i = size_t{0}; i < c.index.size(); i++){
+            ref[c.index[i]] += c.values[i];
+        }
+        auto const t = make_csf( sort_entries( c.index.data(), c.values.data(), c.index.size(), size_t(e.product()), std::plus<>{}, threads ),
+                                 e, threads );
+        auto const rank = t.extents.size();
+        CHECK( t.fids.size() == rank && t.fptr.size() == rank - 1u && t.values.size() == ref.size() );
+
+        // walk the fiber tree depth first and rebuild every linear index
+        auto got = std::map<size_t, long>{};
+        auto walk = [&](auto&& self, size_t l, size_t f, size_t prefix) -> void{
+            auto const k = prefix * size_t(t.extents[l]) + t.fids[l][f];
+            if( l + 1u == rank ){
+                got[k] = t.values[f];
+                return;
+            }
+            for(auto ch = t.fptr[l][f]; ch < t.fptr[l][f + 1u]; ch++){
+                self(self, l + 1u, ch, k);
+            }
+        };
+        for(auto f = size_t{0}; f < t.fids[0].size(); f++){
+            walk(walk, 0u, f, 0u);
+        }
+        CHECK( got == ref );
+    }
+
+}
+
+int main(){
+    for(auto threads : {size_t{1}, size_t{3}, size_t{8}}){
+        check_sort( random_entries(5000, 1000, 1u), 1000, threads );
+        check_sort( random_entries(3000, size_t{1} << 40, 2u), size_t{1} << 40, threads );
+        check_sort( random_entries(10, 1, 3u), 1, threads );
+        check_sort( coo{}, 10, threads );
+        check_csr( random_entries(2000, 37 * 53, 4u), 37, 53, threads );
+        check_csr( random_entries(5, 100 * 3, 5u), 100, 3, threads );
+        check_csr( coo{}, 4, 4, threads );
+        check_csr( coo{}, 3, 0, threads );
+        check_csf( random_entries(3000, 6 * 7 * 8 * 9, 6u), mdspan::extents<mdspan::dynamic_dims>{6, 7, 8, 9}, threads );
+        check_csf( random_entries(50, 5 * 40, 7u), mdspan::extents<2,5,40>{}, threads );
+        check_csf( random_entries(20, 30, 8u), mdspan::extents<mdspan::dynamic_dims>{30}, threads );
+    }
+
+    auto bad = random_entries(10, 50, 9u);
+    bad.index[4] = 50;
+    CHECK_THROWS( std::out_of_range, sort_entries( bad.index.data(), bad.values.data(), bad.index.size(), 50 ) );
+    auto const c = random_entries(10, 50, 10u);
+    CHECK_THROWS( std::out_of_range, make_csr( sort_entries( c.index.data(), c.values.data(), c.index.size(), 50 ), 4, 4 ) );
+    CHECK_THROWS( std::out_of_range, make_csf( sort_entries( c.index.data(), c.values.data(), c.index.size(), 50 ),
+                                               mdspan::extents<mdspan::dynamic_dims>{2, 3} ) );
+
+    auto m = make_map_compression( sort_entries( c.index.data(), c.values.data(), c.index.size(), 50 ), 50 );
+    auto ref = std::map<size_t, long>{};
+    for(auto i = size_t{0}; i < c.index.size(); i++) ref[c.index[i]] += c.values[i];
+    auto ok = true;
+    for(auto k = size_t{0}; k < 50; k++){
+        ok = ok && m.at(k) == ( ref.count(k) ? ref[k] : 0 );
+    }
+    CHECK( ok );
+    return checks::report("sparse_builder");
+}
@@ -0,0 +1,132 @@
+// stencil and convolve against a brute-force sum over all points for every boundary policy, with
+// run-time and fixed neighbourhoods, halos wider than the tensor, rows crossing the 512-element
+// tile, and one or several threads.
+
+#include "stencil.h"
+#include "check.h"
+#include <vector>
+
+using namespace test;
+using D = dims<dynamic_dims>;
+
+namespace{
+
+    tensor<double, D> make(D e){
+        return tensor<double, D>( std::move(e), [](size_t i){ return double( int( ( i * 7u + 3u ) % 17u ) - 8 ); } );
+    }
+
+    /** @brief Resolves y into [0, n) by the boundary policy, or returns -1 for a zero neighbour */
+    ptrdiff_t resolve(ptrdiff_t y, ptrdiff_t n, boundary bc){
+        if( y >= 0 && y < n ) return y;
+        switch( bc ){
+            case boundary::clamp: return y < 0 ? 0 : n - 1;
+            case boundary::periodic: return ( ( y % n ) + n ) % n;
+            default: return -1;
+        }
+    }
+
+    /** @brief out(x) = sum_p w_p a(x + d_p), every point resolved on its own */
+    template< typename N >
+    std::vector<double> brute(tensor<double, D> const& a, N const& nb, boundary bc){
+        auto const& e = a.extents().base();
+        auto const r = e.size();
+        auto out = std::vector<double>( a.size(), 0. );
+        auto x = std::vector<ptrdiff_t>(r, 0);
+        for(auto i = size_t{0}; i < a.size(); i++){
+            auto lin = i;
+            for(auto k = r; k-- > 0u;){
+                x[k] = ptrdiff_t( lin % size_t(e[k]) );
+                lin /= size_t(e[k]);
+            }
+            for(auto p = size_t{0}; p < nb.size(); p++){
+                auto off = ptrdiff_t{0};
+                auto inside = true;
+                for(auto k = size_t{0}; k < r; k++){
+                    auto const y = resolve( x[k] + nb.offset(p, k), e[k], bc );
+                    inside = inside && y >= 0;
+                    off = off * e[k] + y;
+                }
+                if( inside ){
+                    out[i] += nb.weight(p) * a.at( size_t(off) );
+                }
+            }
+        }
+        return out;
+    }
+
+    template< typename N >
+    void check_stencil(D e, N const& nb){
+        auto const a = make( std::move(e) );
+        for(auto bc : {boundary::clamp, boundary::periodic, boundary::zero}){
+            auto const ref = brute(a, nb, bc);
+            for(auto threads : {size_t{1}, size_t{3}}){
+                auto const out = stencil(a, nb, bc, threads);
+                auto ok = out.size() == ref.size();
+                for(auto i = size_t{0}; ok && i < ref.size(); i++){
+                    ok = out.at(i) == ref[i];
+                }
+                CHECK( ok );
+            }
+        }
+    }
+
+}
+
+int main(){
+    {
+        // asymmetric five points along a row longer than one tile
+        auto nb = neighbourhood<double>(1);
+        nb.add({-2}, 1.);
+        nb.add({-1}, -2.);
+        nb.add({0}, 3.);
+        nb.add({1}, .5);
+        nb.add({3}, -1.);
+        check_stencil( D{1100}, nb );
+        check_stencil( D{512}, nb );
+        check_stencil( D{4}, nb );    // the halo covers the whole row
+    }
+    {
+        auto nb = neighbourhood<double>(2);
+        nb.add({0, 0}, 2.);
+        nb.add({-1, 2}, 1.);
+        nb.add({5, -1}, -1.);         // reaches further than the outer extent
+        check_stencil( D{3, 600}, nb );
+        check_stencil( D{7, 9}, nb );
+    }
+    check_stencil( D{6, 5}, star_stencil<double,2>(-4., 1.) );
+    check_stencil( D{5, 4, 530}, star_stencil<double,3>(-6., 1.) );
+    check_stencil( D{1, 1, 3}, star_stencil<double,3>(-6., 1.) );
+    {
+        // an empty neighbourhood gives zeros
+        auto const a = make( D{3, 4} );
+        auto const out = stencil( a, neighbourhood<double>(2), boundary::periodic );
+        auto ok = true;
+        for(auto i = size_t{0}; i < out.size(); i++) ok = ok && out.at(i) == 0.;
+        CHECK( ok );
+    }
+    {
+        // convolve flips the kernel, which is centred at extent / 2
+        auto const a = make( D{6, 7} );
+        auto const kernel = tensor<double, D>( D{3, 2}, [](size_t i){ return double(i) - 2.; } );
+        auto flipped = neighbourhood<double>(2);
+        for(auto i = ptrdiff_t{0}; i < 3; i++){
+            for(auto j = ptrdiff_t{0}; j < 2; j++){
+                flipped.add( {1 - i, 1 - j}, kernel.at( size_t(i * 2 + j) ) );
+            }
+        }
+        for(auto bc : {boundary::clamp, boundary::periodic, boundary::zero}){
+            auto const out = convolve(a, kernel, bc);
+            auto const ref = brute(a, flipped, bc);
+            auto ok = true;
+            for(auto i = size_t{0}; i < ref.size(); i++) ok = ok && out.at(i) == ref[i];
+            CHECK( ok );
+        }
+    }
+    {
+        auto const a = make( D{3, 4} );
+        auto out = tensor<double, D>( D{3, 5}, storage_type::uninitialized );
+        CHECK_THROWS( std::length_error, stencil(a, star_stencil<double,3>(1., 1.)) );
+        CHECK_THROWS( std::length_error, stencil(a, star_stencil<double,2>(1., 1.), out) );
+    }
+    return checks::report("stencil");
+}
@@ -0,0 +1,88 @@
+// Out-of-core passes over file_tensor against in-memory results, including chunk sizes that do
+// not divide the tensor and exceptions thrown by the element functions while I/O is in flight.
+
+#include "streaming.h"
+#include "check.h"
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+using namespace streaming;
+using E = mdspan::extents<mdspan::dynamic_dims>;
+
+namespace{
+
+    std::string temp_path(char const* name){
+        return ( std::filesystem::temp_directory_path() / name ).string();
+    }
+
+    std::vector<float> read_all(std::string const& path, size_t n){
+        auto v = std::vector<float>(n);
+        auto f = detail::open(path, "rb");
+        detail::read(f.get(), v.data(), n);
+        return v;
+    }
+
+}
+
+int main(){
+    auto const a = file_tensor<float>( temp_path("mdspan_streaming_a.bin"), E{37, 5, 3} );
+    auto const b = file_tensor<double>( temp_path("mdspan_streaming_b.bin"), E{37, 15} );
+    auto const n = a.size();
+    // 7 slices of 15 floats per chunk, so the last chunk is partial
+    auto const chunk = 7u * 15u * sizeof(float);
+
+    stream_generate( a, [](size_t i){ return float(i % 11u); }, chunk );
+    auto const v = read_all(a.path(), n);
+    auto ok = v.size() == n;
+    for(auto i = size_t{0}; i < n; i++){
+        ok = ok && v[i] == float(i % 11u);
+    }
+    CHECK( ok );
+
+    auto ref = 0.0;
+    for(auto x : v){
+        ref += x;
+    }
+    CHECK( stream_reduce( a, 0.0, [](double s, float x){ return s + x; }, chunk ) == ref );
+
+    stream_transform( a, b, [](float x){ return double(x) * 2.0; }, chunk );
+    {
+        auto w = std::vector<double>(n);
+        auto f = detail::open(b.path(), "rb");
+        detail::read(f.get(), w.data(), n);
+        ok = true;
+        for(auto i = size_t{0}; i < n; i++){
+            ok = ok && w[i] == 2.0 * v[i];
+        }
+        CHECK( ok );
+    }
+
+    // throwing while the previous chunk is still being written must not touch freed buffers
+    for(auto rep = 0; rep < 20; rep++){
+        CHECK_THROWS( std::runtime_error, stream_generate( a, [](size_t i){
+            if( i == 7u * 15u ) throw std::runtime_error("gen");
+            return float(i);
+        }, chunk ) );
+        CHECK_THROWS( std::runtime_error, stream_transform( a, b, [](float x){
+            if( x == 10.f ) throw std::runtime_error("f");
+            return double(x);
+        }, chunk ) );
+    }
+
+    CHECK_THROWS( std::length_error, stream_transform( a, file_tensor<double>( b.path(), E{3} ), [](float x){ return double(x); } ) );
+
+    // in-place use is rejected before the input is truncated, also through another spelling of the path
+    stream_generate( a, [](size_t i){ return float(i % 11u); }, chunk );
+    auto const dotted = ( std::filesystem::temp_directory_path() / "." / "mdspan_streaming_a.bin" ).string();
+    CHECK_THROWS( std::invalid_argument, stream_transform( a, a, [](float x){ return x; }, chunk ) );
+    CHECK_THROWS( std::invalid_argument, stream_transform( a, file_tensor<float>( dotted, E{37, 15} ), [](float x){ return x; }, chunk ) );
+    CHECK( read_all(a.path(), n) == v );
+    CHECK_THROWS( std::runtime_error, stream_reduce( file_tensor<float>( temp_path("mdspan_streaming_missing/x.bin"), E{4} ), 0.0,
+                                                     [](double s, float x){ return s + x; } ) );
+
+    std::remove( a.path().c_str() );
+    std::remove( b.path().c_str() );
+    return checks::report("streaming");
+}
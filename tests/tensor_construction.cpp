@@ -0,0 +1,45 @@
+// Tensors constructed directly from extents: value-initialized, filled, generated and
+// uninitialized storage, for dense, shared and sparse storage policies.
+
+#include "tensor.h"
+#include "check.h"
+#include <vector>
+
+using namespace test;
+using D = dims<mdspan::dynamic_dims>;
+
+namespace{
+
+    template< typename A >
+    void check_dense(){
+        using T = tensor<int, D, int, A>;
+        auto const e = D{3, 4, 5};
+
+        auto z = T(e);
+        auto f = T(e, 7);
+        auto g = T(e, [](size_t k){ return int(k * 3u); });
+        auto u = T(e, storage_type::uninitialized);
+        CHECK( z.size() == 60u && f.size() == 60u && g.size() == 60u && u.size() == 60u );
+        auto ok = true;
+        for(auto k = size_t{0}; k < 60u; k++){
+            ok = ok && z.at(k) == 0 && f.at(k) == 7 && g.at(k) == int(k * 3u);
+        }
+        CHECK( ok );
+    }
+
+}
+
+int main(){
+    check_dense< std::vector<int> >();
+    check_dense< storage_type::dense_tensor::uninitialized_vector<int> >();
+    check_dense< storage_type::dense_tensor::dense<int, std::vector<int>> >();
+    check_dense< storage_type::dense_tensor::shared_dense<int> >();
+
+    using M = storage_type::sparse_tensor::map_compression<int>;
+    auto s = tensor<int, D, int, M>( D{4, 5} );
+    CHECK( s.at(3) == 0 );
+    s.set(9, 3);
+    CHECK( s.at(3) == 9 );
+    // tensor<int, D, int, M>( e, 5 ) does not compile: sparse storage cannot be filled
+    return checks::report("tensor_construction");
+}
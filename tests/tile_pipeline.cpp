@@ -0,0 +1,131 @@
+// tile_transform over every combination of memory, mapped and file input and output against an
+// element-wise loop, with tiles that do not divide the tensor, one or several compute threads and
+// a single tile in flight, kernel and I/O errors propagated to the caller, and in-place file
+// transforms rejected.
+//
+//   g++ -std=c++20 -Wall -Wextra -fsanitize=address,undefined -Iincludes -pthread tests/tile_pipeline.cpp -o t && ./t
+
+#include "tile_pipeline.h"
+#include "check.h"
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+using namespace streaming;
+using E = mdspan::extents<mdspan::dynamic_dims>;
+
+namespace{
+
+    std::string temp_path(char const* name){
+        return ( std::filesystem::temp_directory_path() / name ).string();
+    }
+
+    template< typename T >
+    std::vector<T> read_all(std::string const& path, size_t n){
+        auto v = std::vector<T>(n);
+        auto f = detail::open(path, "rb");
+        detail::read(f.get(), v.data(), n);
+        return v;
+    }
+
+    // out = 2 in + offset of the element, so a tile written at the wrong place is detected
+    auto const kernel = [](float const* in, double* out, size_t n, size_t offset){
+        for(auto i = size_t{0}; i < n; i++){
+            out[i] = 2. * in[i] + double(offset + i);
+        }
+    };
+
+    bool expected(std::vector<float> const& in, std::vector<double> const& out){
+        auto ok = in.size() == out.size();
+        for(auto i = size_t{0}; ok && i < in.size(); i++){
+            ok = out[i] == 2. * in[i] + double(i);
+        }
+        return ok;
+    }
+
+}
+
+int main(){
+    auto const e = E{41, 3, 5};
+    auto const n = static_cast<size_t>( e.product() );
+    auto src = std::vector<float>(n);
+    for(auto i = size_t{0}; i < n; i++){
+        src[i] = float( int( i * 7u % 23u ) - 11 );
+    }
+    auto const in = file_tensor<float>( temp_path("mdspan_tiles_in.bin"), e );
+    auto const out = file_tensor<double>( temp_path("mdspan_tiles_out.bin"), e );
+    {
+        auto f = detail::open(in.path(), "wb");
+        detail::write(f.get(), src.data(), n);
+    }
+
+    for(auto threads : {size_t{1}, size_t{3}}){
+        for(auto in_flight : {size_t{0}, size_t{1}}){
+            // 4 slices of 15 floats per tile, so the last tile is partial
+            auto const o = pipeline_options{ 4u * 15u * sizeof(float), threads, in_flight };
+
+            auto mem = std::vector<double>(n, -1.);
+            tile_transform( src.data(), e, mem.data(), kernel, o );
+            CHECK( expected(src, mem) );
+
+            tile_transform( src.data(), e, out, kernel, o );
+            CHECK( expected(src, read_all<double>(out.path(), n)) );
+
+            std::fill(mem.begin(), mem.end(), -1.);
+            tile_transform( in, mem.data(), kernel, o );
+            CHECK( expected(src, mem) );
+
+            std::filesystem::remove(out.path());
+            tile_transform( in, out, kernel, o );
+            CHECK( expected(src, read_all<double>(out.path(), n)) );
+
+            auto const m = mapped_tensor<float>( in );
+            std::fill(mem.begin(), mem.end(), -1.);
+            tile_transform( m.data(), e, mem.data(), kernel, o );
+            CHECK( m.size() == n && expected(src, mem) );
+        }
+    }
+    {
+        // a tile larger than the tensor gives a single tile
+        auto mem = std::vector<double>(n);
+        tile_transform( in, mem.data(), kernel );
+        CHECK( expected(src, mem) );
+    }
+    {
+        // the first error of any tile is rethrown once all tiles in flight have finished
+        auto const o = pipeline_options{ 15u * sizeof(float), 3u, 4u };
+        auto const failing = [](float const*, double*, size_t, size_t offset){
+            if( offset == 20u * 15u ){
+                throw std::domain_error("tile 20");
+            }
+        };
+        auto mem = std::vector<double>(n);
+        CHECK_THROWS( std::domain_error, tile_transform( src.data(), e, mem.data(), failing, o ) );
+        CHECK_THROWS( std::domain_error, tile_transform( in, out, failing, o ) );
+        // the pipeline is usable again afterwards
+        tile_transform( in, mem.data(), kernel, o );
+        CHECK( expected(src, mem) );
+    }
+    {
+        auto mem = std::vector<double>(n);
+        auto const missing = file_tensor<float>( temp_path("mdspan_tiles_missing.bin"), e );
+        std::filesystem::remove(missing.path());
+        CHECK_THROWS( std::runtime_error, tile_transform( missing, mem.data(), kernel ) );
+        CHECK_THROWS( std::runtime_error, mapped_tensor<float>( missing ) );
+        // the input file holds fewer elements than its extents claim
+        auto const longer = file_tensor<float>( in.path(), E{42, 3, 5} );
+        auto more = std::vector<double>( longer.size() );
+        CHECK_THROWS( std::runtime_error, tile_transform( longer, more.data(), kernel ) );
+        CHECK_THROWS( std::runtime_error, mapped_tensor<float>( longer ) );
+        CHECK_THROWS( std::length_error, tile_transform( longer, out, kernel ) );
+        CHECK_THROWS( std::length_error, tile_transform( src.data(), E{41, 3, 4}, out, kernel ) );
+        // in place would truncate the input before it is read
+        auto const aliased = file_tensor<float>( ( std::filesystem::path(in.path()).parent_path() / "." / "mdspan_tiles_in.bin" ).string(), e );
+        CHECK_THROWS( std::invalid_argument, tile_transform( in, in, [](float const*, float*, size_t, size_t){} ) );
+        CHECK_THROWS( std::invalid_argument, tile_transform( in, aliased, [](float const*, float*, size_t, size_t){} ) );
+        CHECK( read_all<float>(in.path(), n) == src );
+    }
+    std::filesystem::remove(in.path());
+    std::filesystem::remove(out.path());
+    return checks::report("tile_pipeline");
+}
@@ -0,0 +1,81 @@
+// topk against a stable sort of every fiber, for every mode, both comparators and k from 1 to the
+// extent, with many ties, so the in-place, row-streaming and scratch strategies and their tile
+// boundaries are all covered; and the mode and k errors.
+
+#include "topk.h"
+#include "check.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace test;
+using D = dims<dynamic_dims>;
+
+namespace{
+
+    template< typename Compare >
+    void check_topk(tensor<int, D> const& a, size_t mode, size_t k, Compare comp, size_t threads){
+        auto const& e = a.extents().base();
+        auto const n = size_t(e[mode]);
+        auto outer = size_t{1}, inner = size_t{1};
+        for(auto q = size_t{0}; q < e.size(); q++){
+            if( q < mode ) outer *= size_t(e[q]);
+            if( q > mode ) inner *= size_t(e[q]);
+        }
+        auto const r = topk(a, mode, k, comp, threads);
+        auto eo = e;
+        eo[mode] = ptrdiff_t(k);
+        auto ok = r.values.extents() == D(eo) && r.indices.extents() == D(eo);
+
+        auto f = std::vector<size_t>(n);
+        for(auto l = size_t{0}; ok && l < outer; l++){
+            for(auto c = size_t{0}; c < inner; c++){
+                auto const at = [&](size_t i){ return a.at( ( l * n + i ) * inner + c ); };
+                for(auto i = size_t{0}; i < n; i++) f[i] = i;
+                // ties keep increasing position
+                std::stable_sort(f.begin(), f.end(), [&](size_t x, size_t y){ return comp(at(x), at(y)); });
+                for(auto j = size_t{0}; j < k; j++){
+                    auto const o = ( l * k + j ) * inner + c;
+                    ok = ok && r.values.at(o) == at(f[j]) && r.indices.at(o) == f[j];
+                }
+            }
+        }
+        CHECK( ok );
+    }
+
+}
+
+int main(){
+    auto g = std::mt19937(11u);
+    // the last extent of {2,40,1030} crosses the 1024-fiber row tile, {50,3,40} the 16-fiber scratch tile
+    for(auto const& e : { D{300}, D{7, 200}, D{50, 3, 40}, D{2, 40, 1030}, D{2, 17, 5, 3}, D{1, 1}, D{9, 1, 2} }){
+        auto const a = tensor<int, D>( e, [&](size_t){ return int( g() % 20u ) - 10; } );
+        for(auto mode = size_t{0}; mode < e.rank(); mode++){
+            auto const n = size_t( e[mode] );
+            for(auto k : { size_t{1}, size_t{3}, n / 8u, n / 8u + 1u, n }){
+                if( k == 0u || k > n ) continue;
+                for(auto threads : { size_t{1}, size_t{3} }){
+                    check_topk(a, mode, k, std::greater<>{}, threads);
+                    check_topk(a, mode, k, std::less<>{}, threads);
+                }
+            }
+        }
+    }
+    {
+        // a comparator on a derived key: the k closest to 3
+        auto const a = tensor<int, D>( D{3, 64}, [](size_t i){ return int( i * 7u % 23u ); } );
+        check_topk(a, 1, 5, [](int x, int y){ return std::abs(x - 3) < std::abs(y - 3); }, 2);
+        check_topk(a, 0, 2, [](int x, int y){ return std::abs(x - 3) < std::abs(y - 3); }, 2);
+    }
+    {
+        auto const a = tensor<int, D>( D{3, 4} );
+        CHECK_THROWS( std::length_error, topk(a, 2, 1) );
+        CHECK_THROWS( std::length_error, topk(a, 1, 0) );
+        CHECK_THROWS( std::length_error, topk(a, 1, 5) );
+        auto const r = topk(a, 0, 3);
+        CHECK( r.indices.at(0) == 0u && r.indices.at(4) == 1u && r.indices.at(11) == 2u );
+    }
+    return checks::report("topk");
+}
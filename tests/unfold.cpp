@@ -0,0 +1,143 @@
+// Mode-k unfoldings against the multi-index definition for every mode of several shapes: element
+// access, the panel split, both gemm overloads with strided operands and beta, and gram.
+
+#include "unfold.h"
+#include "check.h"
+#include <algorithm>
+#include <vector>
+
+using namespace test;
+using D = dims<dynamic_dims>;
+
+namespace{
+
+    tensor<double, D> make(D e, unsigned seed){
+        return tensor<double, D>( std::move(e), [seed](size_t i){ return double( int( ( i * 5u + seed ) % 11u ) - 5 ); } );
+    }
+
+    /** @brief Linear index of the element in row i, column j of the mode-k unfolding of extents e */
+    size_t brute_index(std::vector<ptrdiff_t> const& e, size_t k, size_t i, size_t j){
+        auto idx = std::vector<size_t>(e.size());
+        idx[k] = i;
+        for(auto q = e.size(); q-- > 0u;){
+            if( q == k ) continue;
+            idx[q] = j % size_t(e[q]);
+            j /= size_t(e[q]);
+        }
+        auto lin = size_t{0};
+        for(auto q = size_t{0}; q < e.size(); q++){
+            lin = lin * size_t(e[q]) + idx[q];
+        }
+        return lin;
+    }
+
+    void check_mode(D const& e, size_t k){
+        auto const t = make(e, 2u);
+        auto const& v = e.base();
+        auto const x = unfold(t, k);
+        auto const rows = x.rows(), cols = x.cols();
+        CHECK( rows == size_t(v[k]) && rows * cols == t.size() && x.mode() == k );
+        CHECK( x.col_extents() == remove_extent_item(e, k) );
+
+        auto ok = true;
+        for(auto i = size_t{0}; i < rows; i++){
+            for(auto j = size_t{0}; j < cols; j++){
+                ok = ok && &x(i, j) == t.data() + brute_index(v, k, i, j);
+            }
+        }
+        CHECK( ok );
+
+        // the panels cover every column once
+        auto seen = std::vector<int>(cols, 0);
+        for(auto p = size_t{0}; p < x.panels(); p++){
+            auto const xp = x.panel(p);
+            for(auto c = size_t{0}; c < xp.cols; c++){
+                auto const j = size_t( x.col_offset(p) + ptrdiff_t(c) * x.col_stride() );
+                ok = ok && j < cols && xp.rows == rows;
+                for(auto i = size_t{0}; ok && i < rows; i++){
+                    ok = &xp(i, c) == &x(i, j);
+                }
+                if( ok ) seen[j]++;
+            }
+        }
+        CHECK( ok && std::count(seen.begin(), seen.end(), 1) == std::ptrdiff_t(cols) );
+
+        // C = 2 X B - C with B transposed in memory and C on every other column
+        auto const n = size_t{3};
+        auto b = std::vector<double>(cols * n), c = std::vector<double>(rows * n * 2u);
+        for(auto q = size_t{0}; q < b.size(); q++) b[q] = double( int( q % 7u ) - 3 );
+        for(auto q = size_t{0}; q < c.size(); q++) c[q] = double( int( q % 5u ) );
+        auto ref = c;
+        gemm( n, 2., x, b.data(), ptrdiff_t{1}, ptrdiff_t(cols), -1., c.data(), ptrdiff_t(2u * n), ptrdiff_t{2} );
+        for(auto i = size_t{0}; i < rows; i++){
+            for(auto l = size_t{0}; l < n; l++){
+                auto s = 0.;
+                for(auto j = size_t{0}; j < cols; j++) s += t.at( brute_index(v, k, i, j) ) * b[l * cols + j];
+                auto& r = ref[i * 2u * n + l * 2u];
+                r = 2. * s - r;
+            }
+        }
+        CHECK( c == ref );
+
+        // Y_(k) = A X_(k) + 0.5 Y_(k) where Y has extent m in mode k
+        auto const m = ptrdiff_t{4};
+        auto ve = v;
+        ve[k] = m;
+        auto y = make( D(ve), 7u );
+        auto const y0 = y;
+        auto a = std::vector<double>( size_t(m) * rows );
+        for(auto q = size_t{0}; q < a.size(); q++) a[q] = double( int( q % 3u ) - 1 );
+        gemm( 1., a.data(), ptrdiff_t(rows), ptrdiff_t{1}, x, .5, unfold(y, k) );
+        for(auto i = size_t{0}; i < size_t(m); i++){
+            for(auto j = size_t{0}; j < cols; j++){
+                auto s = 0.;
+                for(auto q = size_t{0}; q < rows; q++) s += a[i * rows + q] * t.at( brute_index(v, k, q, j) );
+                auto const lin = brute_index(ve, k, i, j);
+                ok = ok && y.at(lin) == s + .5 * y0.at(lin);
+            }
+        }
+        CHECK( ok );
+
+        // G = X X^T, through the tensor overload and into a strided, transposed buffer
+        auto const g = gram(t, k);
+        auto gt = std::vector<double>(rows * rows * 2u, -1.);
+        gram( x, gt.data(), ptrdiff_t{1}, ptrdiff_t(2u * rows) );
+        for(auto i = size_t{0}; i < rows; i++){
+            for(auto l = size_t{0}; l < rows; l++){
+                auto s = 0.;
+                for(auto j = size_t{0}; j < cols; j++) s += t.at( brute_index(v, k, i, j) ) * t.at( brute_index(v, k, l, j) );
+                ok = ok && g.at(i * rows + l) == s && gt[i + l * 2u * rows] == s;
+            }
+        }
+        CHECK( ok && g.extents() == D{ptrdiff_t(rows), ptrdiff_t(rows)} );
+    }
+
+}
+
+int main(){
+    for(auto const& e : { D{5}, D{4, 6}, D{3, 4, 5}, D{2, 7, 3}, D{6, 2, 2, 3}, D{1, 3, 1}, D{40, 3, 70} }){
+        for(auto k = size_t{0}; k < e.rank(); k++){
+            check_mode(e, k);
+        }
+    }
+    {
+        // a mutable unfolding writes through to the tensor and converts to a read-only one
+        auto t = make( D{2, 3, 4}, 0u );
+        auto const x = unfold(t, 1);
+        x(2, 5) = 100.;
+        CHECK( t.at( brute_index({2, 3, 4}, 1, 2, 5) ) == 100. );
+        auto const cx = unfolding<double const>(x);
+        CHECK( &cx(2, 5) == &x(2, 5) && cx.panels() == x.panels() );
+    }
+    {
+        auto t = make( D{2, 3, 4}, 0u );
+        auto const& ct = t;
+        auto y = make( D{2, 5, 3}, 0u );
+        double a[4] = {};
+        CHECK_THROWS( std::length_error, unfold(ct, 3) );
+        CHECK_THROWS( std::length_error, unfold(t, 3) );
+        // mode 1 of {2,3,4} has columns {2,4}, mode 1 of {2,5,3} has {2,3}
+        CHECK_THROWS( std::length_error, gemm( 1., a, 1, 1, unfold(ct, 1), 0., unfold(y, 1) ) );
+    }
+    return checks::report("unfold");
+}